@@ -1,30 +1,205 @@
+import asyncio
+import hashlib
+import json
+import re
+import threading
 from abc import ABC, abstractmethod
+from collections import OrderedDict
+from dataclasses import dataclass
+from typing import Any, Callable, Optional
 
+from langchain_core.messages import BaseMessage, HumanMessage, SystemMessage
 from loguru import logger
 
-from .config import PROMPT_TEMPLATES_DIR
-from .llms import LLM
+from .cache import AnalysisCache
+from .config import (
+    BATCH_CASE_MAX_TOKENS,
+    CONTEXT_CACHE_FILES,
+    CONTEXT_VERDICT_MAX_TOKENS,
+    DEFAULT_CONTEXT_TOKENS,
+    PROMPT_TEMPLATES_DIR,
+    VERDICT_MAX_TOKENS,
+)
+from .extractor import open_result_source, read_scope_code, scope_chain
+from .utils.source import SourceFile
+from .llms import LLM, TokenUsage
+from .metrics import METRICS
+from .utils.tokens import TokenCounter
+from .verdict import format_verdict, is_finding, normalize_verdict, parse_verdict
 
 
 class Analyzer(ABC):
+    # 单条请求的输出 token 上限
+    max_tokens = VERDICT_MAX_TOKENS
+
     def __init__(self, llms: LLM):
         self.llms = llms
         self.prompt = ""
         self.comments = ""
         self.context = ""
+        self.tokens = TokenCounter(llms.model_name)
 
     @abstractmethod
     def load_prompt_template(self):
         raise NotImplementedError()
 
     @abstractmethod
-    def analyze(self):
+    def build_messages(self, comments: str, context: str = "") -> list[BaseMessage]:
         raise NotImplementedError()
 
+    def build_context(
+        self, file_result: dict[str, Any], comment: dict[str, Any]
+    ) -> str:
+        """
+        取注释最内层上下文（函数或类）的源码，模块级注释返回空字符串
+
+        Args:
+            file_result: 注释所在文件的提取结果
+            comment: 注释信息字典
+
+        Returns:
+            作为 {{context}} 的代码文本
+        """
+        chain = scope_chain(file_result, comment.get("scope_id"))
+        if not chain:
+            return ""
+        source = open_result_source(file_result)
+        try:
+            return read_scope_code(source, chain[-1])
+        finally:
+            if source is not None:
+                source.close()
+
+    @property
+    def prompt_version(self) -> str:
+        """提示词模板的版本号，模板内容变化即变化"""
+        return hashlib.sha256(self.prompt.encode("utf-8")).hexdigest()[:16]
+
+    def cache_key(self, comments: str, context: str = "") -> str:
+        return AnalysisCache.make_key(
+            type(self).__name__,
+            self.prompt_version,
+            self.llms.model_id,
+            self.llms.model_config,
+            comments,
+            context,
+        )
+
+    @property
+    def usages(self) -> list[TokenUsage]:
+        """各 LLM 客户端的累计 token 用量，供预算统计"""
+        return [self.llms.usage]
+
+    def log_usage(self) -> None:
+        self.llms.log_usage()
+
+    def analyze(self):
+        messages = self.build_messages(self.comments, self.context)
+        options = self.llms.output_options(self.max_tokens)
+        return self.finish(self.llms.generate(messages, **options))
+
+    async def aanalyze(self, comments: str, context: str = "") -> str:
+        """
+        异步分析单条注释，不读写 self.comments / self.context，可安全并发调用
+        """
+        messages = self.build_messages(comments, context)
+        options = self.llms.output_options(self.max_tokens)
+        return self.finish(await self.llms.agenerate(messages, **options))
+
+    @staticmethod
+    def finish(response: str) -> str:
+        """
+        将 LLM 响应规整为紧凑的 JSON 结论，缓存与报告中保存的都是规整后的文本
+
+        无法解析的响应原样返回：CoRex 将其作为发现写入报告，但不写入缓存与检查点，
+        下一次运行（或 --resume）会重新请求。
+        """
+        verdict = parse_verdict(response)
+        if verdict is None:
+            METRICS.counter("verdicts_unparsed", "Responses without a verdict").inc()
+            logger.warning(f"Cannot parse a verdict from response: {response[:200]}")
+            return response
+        return format_verdict(verdict)
+
+    def make_batches(self, comments: list[str]) -> list[list[int]]:
+        """
+        将注释划分为请求批次，默认每条注释单独一个请求
+
+        Returns:
+            每个批次包含的注释下标
+        """
+        return [[i] for i in range(len(comments))]
+
+    async def aanalyze_batch(
+        self, comments: list[str], contexts: list[str]
+    ) -> list[str]:
+        """
+        分析一个批次的注释，返回与输入一一对应的分析结果
+        """
+        return [await self.aanalyze(c, x) for c, x in zip(comments, contexts)]
+
+    async def aprimary_batch(
+        self, comments: list[str], contexts: list[str]
+    ) -> list[str]:
+        """调度器在自己的并发名额内执行的部分，默认即完整的批次分析"""
+        return await self.aanalyze_batch(comments, contexts)
+
+    async def aescalate(
+        self,
+        comments: list[str],
+        contexts: list[str],
+        responses: list[str],
+        admit: Optional[Callable[[int], bool]] = None,
+    ) -> list[Optional[str]]:
+        """
+        调度器释放并发名额之后执行的后续分析（如级联确认），默认原样返回
+
+        Args:
+            responses: aprimary_batch 的结果
+            admit: 预算检查，每个后续请求提交前调用 admit(1)，返回 False 时不提交
+
+        Returns:
+            最终结果，未得到结论的注释为 None（不写入缓存与检查点）
+        """
+        return responses
+
+
+@dataclass
+class ScopeTokens:
+    """一个作用域的代码行及其 token 数，供同一作用域内的多条注释复用"""
+
+    lines: list[str]
+    total: int
+    # 逐行 token 数，截取窗口用到某一行时才计算
+    line_counts: Optional[list[Optional[int]]] = None
+
+    def line_tokens(self, index: int, tokens: TokenCounter) -> int:
+        if self.line_counts is None:
+            self.line_counts = [None] * len(self.lines)
+        count = self.line_counts[index]
+        if count is None:
+            count = self.line_counts[index] = tokens.count(self.lines[index])
+        return count
+
 
 class AnalyzerWithContext(Analyzer):
-    def __init__(self, llms: LLM):
+    # 结论包含注释与代码两部分
+    max_tokens = CONTEXT_VERDICT_MAX_TOKENS
+
+    def __init__(self, llms: LLM, context_tokens: int = DEFAULT_CONTEXT_TOKENS):
+        """
+        Args:
+            llms: LLM 客户端
+            context_tokens: 单条注释上下文的 token 上限
+        """
         super().__init__(llms=llms)
+        self.context_tokens = context_tokens
+        # (文件, 内容哈希) -> (源文件, {(起始行, 结束行): ScopeTokens})，只保留最近的
+        # 几个文件；调度阶段与 watch 模式的提取线程都会构建上下文，访问时加锁
+        self._scopes: OrderedDict[
+            tuple, tuple[Optional[SourceFile], dict[tuple[int, int], ScopeTokens]]
+        ] = OrderedDict()
+        self._scopes_lock = threading.Lock()
 
         self.load_prompt_template()
 
@@ -32,30 +207,433 @@ class AnalyzerWithContext(Analyzer):
         prompt_path = PROMPT_TEMPLATES_DIR / "analysis_comment_with_context.md"
         with open(prompt_path, "r") as f:
             self.prompt = f.read()
+        self.system_prompt, self.user_prompt = split_prompt_template(
+            self.prompt, "{{comment}}"
+        )
 
-    def analyze(self):
-        prompt_filled = self.prompt.replace("{{comment}}", self.comments).replace(
-            "{{context}}", self.context
+    def build_messages(self, comments: str, context: str = "") -> list[BaseMessage]:
+        user = self.user_prompt.replace("{{comment}}", comments).replace(
+            "{{context}}", context or "None"
         )
-        response = self.llms.generate(prompt_filled)
-        return response
+        return [SystemMessage(self.system_prompt), HumanMessage(user)]
+
+    def build_context(
+        self, file_result: dict[str, Any], comment: dict[str, Any]
+    ) -> str:
+        """
+        在 token 预算内截取最内层作用域的代码
+
+        作用域整体不超过 context_tokens 时原样使用；否则保留作用域首行
+        （函数签名/类声明），并以注释为中心向上下交替扩展代码行，
+        直到预算用完，被省略的部分以 "..." 标出。作用域代码在此时才从源文件
+        截取，分词结果按文件缓存，同一作用域内的多条注释只读取与分词一次。
+        """
+        chain = scope_chain(file_result, comment.get("scope_id"))
+        if not chain:
+            return ""
+        scope = chain[-1]
+        with self._scopes_lock:
+            return self._window(self._scope_tokens(file_result, scope), scope, comment)
+
+    def _window(
+        self, tokens: ScopeTokens, scope: dict[str, Any], comment: dict[str, Any]
+    ) -> str:
+        lines = tokens.lines
+        if tokens.total <= self.context_tokens:
+            return "\n".join(lines)
+
+        def cost_of(index: int) -> int:
+            return tokens.line_tokens(index, self.tokens)
+
+        # 注释在作用域代码中的行下标（作用域首行为 0）
+        first = max(0, comment["start_line"] - scope["start_line"])
+        last = min(len(lines) - 1, comment["end_line"] - scope["start_line"])
+
+        budget = self.context_tokens - cost_of(0)
+        lo, hi = first, last
+        budget -= sum(cost_of(i) for i in range(lo, hi + 1))
+        grew = True
+        while grew and budget > 0:
+            grew = False
+            for candidate in (lo - 1, hi + 1):
+                if not 0 < candidate < len(lines):
+                    continue
+                cost = cost_of(candidate)
+                if cost > budget:
+                    continue
+                budget -= cost
+                lo, hi = min(lo, candidate), max(hi, candidate)
+                grew = True
+
+        window = [lines[0]] if lo > 0 else []
+        if lo > 1:
+            window.append("...")
+        window.extend(lines[lo : hi + 1])
+        if hi < len(lines) - 1:
+            window.append("...")
+        return "\n".join(window)
+
+    def _scope_tokens(
+        self, file_result: dict[str, Any], scope: dict[str, Any]
+    ) -> ScopeTokens:
+        """取作用域的分词结果，未缓存时读取并分词一次；调用方持有 _scopes_lock"""
+        if file_result.get("content_hash") is None:
+            # 无法判断内容是否变化，不缓存
+            source = open_result_source(file_result)
+            code = read_scope_code(source, scope)
+            if source is not None:
+                source.close()
+            return ScopeTokens(code.split("\n"), self.tokens.count(code))
+        file_key = (file_result.get("file"), file_result.get("content_hash"))
+        entry = self._scopes.get(file_key)
+        if entry is None:
+            entry = self._scopes[file_key] = (open_result_source(file_result), {})
+            if len(self._scopes) > CONTEXT_CACHE_FILES:
+                source, _ = self._scopes.popitem(last=False)[1]
+                if source is not None:
+                    source.close()
+        else:
+            self._scopes.move_to_end(file_key)
+        source, scopes = entry
+        scope_key = (scope["start_line"], scope["end_line"])
+        tokens = scopes.get(scope_key)
+        if tokens is None:
+            code = read_scope_code(source, scope)
+            tokens = ScopeTokens(code.split("\n"), self.tokens.count(code))
+            scopes[scope_key] = tokens
+        return tokens
 
 
 class AnalyzerWithoutContext(Analyzer):
-    def __init__(self, llms: LLM):
+    def __init__(
+        self,
+        llms: LLM,
+        batch_size: int = 1,
+        batch_tokens: Optional[int] = None,
+    ):
+        """
+        Args:
+            llms: LLM 客户端
+            batch_size: 单个请求最多打包的注释数，1 表示不打包
+            batch_tokens: 单个请求中注释部分的估算 token 上限，None 表示不限制
+        """
         super().__init__(llms=llms)
+        if batch_size < 1:
+            raise ValueError(f"batch_size must be >= 1, got {batch_size}")
+        self.batch_size = batch_size
+        self.batch_tokens = batch_tokens
+        self.batch_format = ""
+        self.batch_system_prompt = ""
         self.load_prompt_template()
 
     def load_prompt_template(self):
         prompt_path = PROMPT_TEMPLATES_DIR / "analysis_comment_without_context.md"
         with open(prompt_path, "r") as f:
             self.prompt = f.read()
+        batch_format_path = PROMPT_TEMPLATES_DIR / "analysis_comment_batch_format.md"
+        with open(batch_format_path, "r") as f:
+            self.batch_format = f.read()
+        self.system_prompt, self.user_prompt = split_prompt_template(
+            self.prompt, "{{Comment}}"
+        )
+        # 批量模式的说明同样是静态内容，放进 system 消息以延长可缓存的前缀
+        self.batch_system_prompt = f"{self.system_prompt}\n\n{self.batch_format}"
+
+    def build_messages(self, comments: str, context: str = "") -> list[BaseMessage]:
+        user = self.user_prompt.replace("{{Comment}}", comments)
+        return [SystemMessage(self.system_prompt), HumanMessage(user)]
+
+    def build_context(
+        self, file_result: dict[str, Any], comment: dict[str, Any]
+    ) -> str:
+        return ""
+
+    @property
+    def prompt_version(self) -> str:
+        # 批量模式的说明同样决定结论，修改任一模板都使缓存失效
+        text = f"{self.prompt}\n{self.batch_format}"
+        return hashlib.sha256(text.encode("utf-8")).hexdigest()[:16]
+
+    def cache_key(self, comments: str, context: str = "") -> str:
+        # 不使用上下文，同一注释在任何位置都命中同一条缓存
+        return super().cache_key(comments)
+
+    def build_batch_messages(self, comments: list[str]) -> list[BaseMessage]:
+        cases = "\n\n".join(
+            f"## Case{i}\n### Comment\n{comment}"
+            for i, comment in enumerate(comments)
+        )
+        user = self.user_prompt.replace("{{Comment}}", cases)
+        return [SystemMessage(self.batch_system_prompt), HumanMessage(user)]
+
+    def make_batches(self, comments: list[str]) -> list[list[int]]:
+        batches: list[list[int]] = []
+        current: list[int] = []
+        current_tokens = 0
+        for i, comment in enumerate(comments):
+            tokens = self.tokens.count(comment)
+            over_budget = (
+                self.batch_tokens is not None
+                and current
+                and current_tokens + tokens > self.batch_tokens
+            )
+            if len(current) >= self.batch_size or over_budget:
+                batches.append(current)
+                current, current_tokens = [], 0
+            current.append(i)
+            current_tokens += tokens
+        if current:
+            batches.append(current)
+        return batches
+
+    async def aanalyze_batch(
+        self, comments: list[str], contexts: list[str]
+    ) -> list[str]:
+        if len(comments) == 1:
+            return [await self.aanalyze(comments[0])]
+
+        options = self.llms.output_options(
+            self.max_tokens + BATCH_CASE_MAX_TOKENS * (len(comments) - 1)
+        )
+        response = await self.llms.agenerate(
+            self.build_batch_messages(comments), **options
+        )
+        cases = split_batch_response(response, len(comments))
+
+        results = []
+        for i, comment in enumerate(comments):
+            if i in cases:
+                results.append(format_verdict(normalize_verdict(cases[i])))
+                continue
+            # 模型漏掉了某个 case 或编号不可信，退回单条请求
+            logger.warning(f"Case{i} missing in batch response, retrying alone")
+            results.append(await self.aanalyze(comment))
+        return results
+
+
+class CascadeAnalyzer(Analyzer):
+    """
+    两级级联分析
+
+    所有注释先由廉价的分流模型（triage，不带上下文、可批量）判断，
+    只有被判为有问题或结论无法解析的注释才升级到强模型，由 confirm
+    结合代码上下文给出最终结论；强模型判为 Normal 的注释不再报告。
+    扫描成本与延迟接近分流模型，报告的精度取决于强模型。
+    """
+
+    def __init__(self, triage: AnalyzerWithoutContext, confirm: AnalyzerWithContext):
+        """
+        Args:
+            triage: 分流分析器，通常使用更快、更便宜的模型或本地模型
+            confirm: 确认分析器，使用强模型并带上下文
+        """
+        super().__init__(llms=triage.llms)
+        self.triage = triage
+        self.confirm = confirm
+        self.load_prompt_template()
+        # 升级请求在调度器释放分流名额后提交，只受强模型自己的并发上限约束，
+        # 慢的强模型不会占住分流请求的名额
+        self.escalations = asyncio.Semaphore(confirm.llms.max_concurrency)
+        self.triaged = 0
+        self.escalated = 0
+        self.confirmed = 0
+
+    def load_prompt_template(self):
+        self.prompt = f"{self.triage.prompt}\n{self.confirm.prompt}"
+
+    def build_messages(self, comments: str, context: str = "") -> list[BaseMessage]:
+        return self.confirm.build_messages(comments, context)
+
+    def build_context(
+        self, file_result: dict[str, Any], comment: dict[str, Any]
+    ) -> str:
+        return self.confirm.build_context(file_result, comment)
+
+    def cache_key(self, comments: str, context: str = "") -> str:
+        return AnalysisCache.make_key(
+            type(self).__name__,
+            self.triage.cache_key(comments),
+            self.confirm.cache_key(comments, context),
+        )
+
+    @property
+    def usages(self) -> list[TokenUsage]:
+        return self.triage.usages + self.confirm.usages
+
+    def make_batches(self, comments: list[str]) -> list[list[int]]:
+        return self.triage.make_batches(comments)
 
     def analyze(self):
-        prompt_filled = self.prompt.replace("{{Comment}}", self.comments)
-        # logger.info(f"Filled Prompt:\n{prompt_filled}")
-        response = self.llms.generate(prompt_filled)
-        return response
+        self.triage.comments = self.comments
+        response = self.triage.analyze()
+        if not is_finding(parse_verdict(response)):
+            return response
+        self.confirm.comments, self.confirm.context = self.comments, self.context
+        return self.confirm.analyze()
+
+    async def aanalyze(self, comments: str, context: str = "") -> Optional[str]:
+        return (await self.aanalyze_batch([comments], [context]))[0]
+
+    async def aanalyze_batch(
+        self, comments: list[str], contexts: list[str]
+    ) -> list[Optional[str]]:
+        responses = await self.aprimary_batch(comments, contexts)
+        return await self.aescalate(comments, contexts, responses)
+
+    async def aprimary_batch(
+        self, comments: list[str], contexts: list[str]
+    ) -> list[str]:
+        with METRICS.time("cascade_triage_seconds"):
+            responses = await self.triage.aanalyze_batch(
+                comments, [""] * len(comments)
+            )
+        self.triaged += len(comments)
+        METRICS.counter(
+            "cascade_triaged", "Comments classified by the triage model"
+        ).inc(len(comments))
+        return responses
+
+    async def aescalate(
+        self,
+        comments: list[str],
+        contexts: list[str],
+        responses: list[str],
+        admit: Optional[Callable[[int], bool]] = None,
+    ) -> list[Optional[str]]:
+        """
+        可疑的注释交给强模型确认
+
+        每个升级请求都计入预算；预算耗尽未提交或确认失败的注释结果为 None，
+        不会把未经确认的分流结论当作最终结论缓存，--resume 时重新分析。
+        """
+        results: list[Optional[str]] = list(responses)
+        suspicious = []
+        for i, response in enumerate(responses):
+            if not is_finding(parse_verdict(response)):
+                continue
+            if admit is not None and not admit(1):
+                results[i] = None
+                continue
+            suspicious.append(i)
+        if not suspicious:
+            return results
+        self.escalated += len(suspicious)
+        METRICS.counter(
+            "cascade_escalated", "Comments escalated to the confirmation model"
+        ).inc(len(suspicious))
+        confirmed = await asyncio.gather(
+            *(self._confirm(comments[i], contexts[i]) for i in suspicious),
+            return_exceptions=True,
+        )
+        for i, response in zip(suspicious, confirmed):
+            if isinstance(response, BaseException):
+                # 单条确认失败不影响同批次其他注释的结论
+                METRICS.counter("analysis_failures", "Comments failed to analyze").inc()
+                logger.error(f"Failed to confirm comment {i} of batch: {response!s}")
+                results[i] = None
+                continue
+            results[i] = response
+            if is_finding(parse_verdict(response)):
+                self.confirmed += 1
+                METRICS.counter(
+                    "cascade_confirmed", "Escalated comments confirmed as issues"
+                ).inc()
+        return results
+
+    async def _confirm(self, comment: str, context: str) -> str:
+        async with self.escalations:
+            with METRICS.time("cascade_confirm_seconds"):
+                return await self.confirm.aanalyze(comment, context)
+
+    def log_usage(self) -> None:
+        if self.triaged:
+            escalated = self.escalated / self.triaged
+            confirmed = self.confirmed / self.escalated if self.escalated else 0.0
+            logger.info(
+                f"Cascade: {self.triaged} comments triaged by "
+                f"{self.triage.llms.model_name}, {self.escalated} escalated "
+                f"({escalated:.1%}) to {self.confirm.llms.model_name}, "
+                f"{self.confirmed} confirmed ({confirmed:.1%} of escalated)"
+            )
+        self.triage.log_usage()
+        self.confirm.log_usage()
+
+
+def split_prompt_template(template: str, placeholder: str) -> tuple[str, str]:
+    """
+    将提示词模板拆成静态的 system 部分与可变的 user 部分
+
+    从第一个占位符所在的一级标题处切开：标题之前的说明、示例等内容不随注释变化，
+    作为 system 消息在所有请求间保持一致，便于服务端的前缀缓存（prompt cache）命中；
+    user 部分只包含该小节，填入注释后尽量短。
+
+    Args:
+        template: 完整的提示词模板
+        placeholder: 第一个可变占位符，如 "{{Comment}}"
+
+    Returns:
+        (system 部分, 含占位符的 user 部分)
+    """
+    index = template.find(placeholder)
+    if index == -1:
+        raise ValueError(f"Placeholder {placeholder} not found in prompt template")
+    heading = template.rfind("\n# ", 0, index)
+    cut = heading + 1 if heading != -1 else index
+    system = template[:cut].rstrip().removesuffix("---").rstrip()
+    return system, template[cut:]
+
+
+def split_batch_response(response: str, count: int) -> dict[int, dict]:
+    """
+    将批量请求的响应拆分为每个 case 的结论
+
+    编号超出 [0, count) 的 case 被丢弃；同一编号出现多次时无法判断哪条结论
+    属于该注释，全部丢弃，由调用方对这些注释退回单条请求。
+
+    Args:
+        response: LLM 返回的文本，期望为 {"cases": [...]}（JSON 模式），
+            也接受裸 JSON 数组或包裹在代码块中的形式
+        count: 批次中的注释数
+
+    Returns:
+        case 下标到结论字典的映射，无法解析的 case 不出现在结果中
+    """
+    start = response.find("[")
+    if start == -1:
+        return {}
+    end = response.rfind("]")
+    try:
+        items = json.loads(response[start : end + 1]) if end > start else []
+    except json.JSONDecodeError:
+        items = None
+    if not isinstance(items, list) or not items:
+        # 数组整体不合法（例如被 max_tokens 截断）时，逐个提取其中完整的对象
+        items = []
+        for match in re.finditer(r"\{[^{}]*\}", response[start:]):
+            try:
+                items.append(json.loads(match.group(0)))
+            except json.JSONDecodeError:
+                continue
+
+    cases: dict[int, dict] = {}
+    duplicated: set[int] = set()
+    for item in items:
+        if not isinstance(item, dict):
+            continue
+        try:
+            case = int(item.pop("case"))
+        except (KeyError, TypeError, ValueError):
+            continue
+        if not 0 <= case < count:
+            logger.warning(f"Dropping Case{case} outside a batch of {count}")
+            continue
+        if case in cases:
+            duplicated.add(case)
+        cases[case] = item
+    for case in duplicated:
+        logger.warning(f"Case{case} answered more than once, dropping it")
+        del cases[case]
+    return cases
 
 
 # python -m corex.analyzer
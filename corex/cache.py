@@ -0,0 +1,210 @@
+import hashlib
+import json
+import os
+import sqlite3
+import time
+import zlib
+from pathlib import Path
+from typing import Any, Optional
+
+from loguru import logger
+
+from .config import EXTRACTION_INDEX_VERSION
+from .metrics import METRICS
+from .utils.source import SourceFile
+
+
+class AnalysisCache:
+    """
+    基于 SQLite 的分析结果缓存
+
+    key 由注释文本、提示词模板版本、模型名称与模型配置共同哈希得到，
+    任一项变化都会自然失效，无需手动清理。
+    """
+
+    def __init__(self, path: Path, commit_every: int = 100):
+        self.path = Path(path)
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        self.conn = sqlite3.connect(self.path)
+        self.conn.execute(
+            "CREATE TABLE IF NOT EXISTS analysis ("
+            "key TEXT PRIMARY KEY, response TEXT NOT NULL, "
+            "model TEXT, created_at REAL)"
+        )
+        self.commit_every = commit_every
+        self.hits = 0
+        self.misses = 0
+        self._uncommitted = 0
+
+    @staticmethod
+    def make_key(*parts: Any) -> str:
+        """对任意可 JSON 序列化的字段计算稳定的 sha256"""
+        payload = json.dumps(parts, ensure_ascii=False, sort_keys=True, default=str)
+        return hashlib.sha256(payload.encode("utf-8")).hexdigest()
+
+    def get(self, key: str) -> Optional[str]:
+        row = self.conn.execute(
+            "SELECT response FROM analysis WHERE key = ?", (key,)
+        ).fetchone()
+        if row is None:
+            self.misses += 1
+            return None
+        self.hits += 1
+        return row[0]
+
+    def put(self, key: str, response: str, model: str = "") -> None:
+        self.conn.execute(
+            "INSERT OR REPLACE INTO analysis VALUES (?, ?, ?, ?)",
+            (key, response, model, time.time()),
+        )
+        self._uncommitted += 1
+        if self._uncommitted >= self.commit_every:
+            self.conn.commit()
+            self._uncommitted = 0
+
+    def merge(self, path: Path) -> int:
+        """
+        合并另一个缓存文件（如其他分片的缓存），已有的 key 保留本地结果
+
+        key 只由注释与模型配置决定，与机器无关，各分片的缓存可以直接合并。
+
+        Returns:
+            新增的条目数
+        """
+        self.conn.commit()
+        self.conn.execute("ATTACH DATABASE ? AS other", (str(path),))
+        try:
+            cursor = self.conn.execute(
+                "INSERT OR IGNORE INTO analysis "
+                "SELECT key, response, model, created_at FROM other.analysis"
+            )
+            self.conn.commit()
+        finally:
+            self.conn.execute("DETACH DATABASE other")
+        return cursor.rowcount
+
+    def close(self) -> None:
+        self.conn.commit()
+        self.conn.close()
+
+    def log_stats(self) -> None:
+        total = self.hits + self.misses
+        ratio = self.hits / total if total else 0.0
+        logger.info(
+            f"Analysis cache: {self.hits} hits, {self.misses} misses "
+            f"({ratio:.1%} hit rate) at {self.path}"
+        )
+
+
+class ExtractionIndex:
+    """
+    基于 SQLite 的提取结果索引，热启动时跳过未变化的文件
+
+    每个文件记录 (mtime, size, 内容哈希, 提取器签名) 与压缩后的提取结果：
+    mtime 与大小都未变化时直接命中，不读取文件；只有 mtime 变化时再比较
+    内容哈希（例如 git checkout 后内容未变），命中则刷新 mtime。
+    签名包含提取器类型、语言、关键词与结果格式版本，不同签名的结果分别保存，
+    注释模式与关键词模式交替运行时互不覆盖。
+    """
+
+    def __init__(self, path: Path, commit_every: int = 100):
+        self.path = Path(path)
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        # 提取生成器由 CoRex 在工作线程中驱动，访问是串行的，允许跨线程使用连接
+        self.conn = sqlite3.connect(self.path, check_same_thread=False)
+        self.conn.execute(
+            "CREATE TABLE IF NOT EXISTS extraction ("
+            "path TEXT NOT NULL, signature TEXT NOT NULL, "
+            "mtime_ns INTEGER, size INTEGER, content_hash TEXT, "
+            "result BLOB NOT NULL, indexed_at REAL, PRIMARY KEY (path, signature))"
+        )
+        self.commit_every = commit_every
+        self.hits = 0
+        self.misses = 0
+        self._uncommitted = 0
+        # 未命中文件在查询时的 stat，写入时使用。先 stat 后解析，
+        # 解析期间文件被修改时下次运行会因 mtime 不同而重新比较哈希
+        self._stats: dict[str, os.stat_result] = {}
+
+    @staticmethod
+    def make_signature(*parts: Any) -> str:
+        return AnalysisCache.make_key(EXTRACTION_INDEX_VERSION, *parts)
+
+    def get(self, file: Path, signature: str) -> Optional[dict[str, Any]]:
+        """
+        查询文件的提取结果
+
+        Returns:
+            未变化时返回缓存的提取结果，否则返回 None
+        """
+        path = str(file)
+        try:
+            stat = os.stat(path)
+        except OSError:
+            return None
+        row = self.conn.execute(
+            "SELECT mtime_ns, size, content_hash, result "
+            "FROM extraction WHERE path = ? AND signature = ?",
+            (path, signature),
+        ).fetchone()
+        if row is not None and row[1] == stat.st_size:
+            if row[0] == stat.st_mtime_ns or self._same_content(file, row[2]):
+                if row[0] != stat.st_mtime_ns:
+                    self._execute(
+                        "UPDATE extraction SET mtime_ns = ? "
+                        "WHERE path = ? AND signature = ?",
+                        (stat.st_mtime_ns, path, signature),
+                    )
+                self.hits += 1
+                METRICS.counter("index_hits", "Files served from the index").inc()
+                return json.loads(zlib.decompress(row[3]))
+        self._stats[path] = stat
+        self.misses += 1
+        METRICS.counter("index_misses", "Files reparsed despite the index").inc()
+        return None
+
+    def put(self, file: Path, signature: str, result: dict[str, Any]) -> None:
+        """写入提取结果；读取或解析失败的文件不写入，下次运行重试"""
+        path = str(file)
+        stat = self._stats.pop(path, None)
+        if stat is None or "error" in result or "content_hash" not in result:
+            return
+        payload = json.dumps(result, ensure_ascii=False, separators=(",", ":"))
+        self._execute(
+            "INSERT OR REPLACE INTO extraction VALUES (?, ?, ?, ?, ?, ?, ?)",
+            (
+                path,
+                signature,
+                stat.st_mtime_ns,
+                stat.st_size,
+                result["content_hash"],
+                zlib.compress(payload.encode("utf-8")),
+                time.time(),
+            ),
+        )
+
+    def _same_content(self, file: Path, content_hash: Optional[str]) -> bool:
+        try:
+            with SourceFile(file) as source:
+                return source.digest() == content_hash
+        except OSError:
+            return False
+
+    def _execute(self, sql: str, params: tuple) -> None:
+        self.conn.execute(sql, params)
+        self._uncommitted += 1
+        if self._uncommitted >= self.commit_every:
+            self.conn.commit()
+            self._uncommitted = 0
+
+    def close(self) -> None:
+        self.conn.commit()
+        self.conn.close()
+
+    def log_stats(self) -> None:
+        total = self.hits + self.misses
+        ratio = self.hits / total if total else 0.0
+        logger.info(
+            f"Extraction index: {self.hits} unchanged, {self.misses} reparsed "
+            f"({ratio:.1%} hit rate) at {self.path}"
+        )
@@ -0,0 +1,89 @@
+import hashlib
+import json
+from pathlib import Path
+from typing import Any
+
+from loguru import logger
+
+
+class CheckpointJournal:
+    """
+    扫描检查点日志
+
+    每分析完一个文件，把其中已得到结果的 (文件, 注释区间, 注释文本与上下文哈希)
+    追加写入 JSONL 日志；--resume 时加载日志并跳过这些注释。注释文本与分析时的
+    上下文都参与 key，因此注释或其所在函数被修改后会重新分析。
+    """
+
+    def __init__(self, path: Path, resume: bool = False):
+        self.path = Path(path)
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        self.done: set[tuple[str, int, int, str]] = set()
+        if resume and self.path.exists():
+            self._load()
+            logger.info(f"Resuming from {self.path}: {len(self.done)} comments done")
+        # 非 resume 模式重新开始，清空旧日志
+        self.file = open(self.path, "a" if resume else "w", encoding="utf-8")
+        self.skipped = 0
+
+    @staticmethod
+    def _key(
+        filename: str, comment: dict[str, Any], context: str = ""
+    ) -> tuple[str, int, int, str]:
+        content = comment.get("text", "")
+        if context:
+            content = f"{content}\0{context}"
+        digest = hashlib.sha1(content.encode("utf-8")).hexdigest()
+        return (
+            filename,
+            comment.get("start_line", 0),
+            comment.get("end_line", 0),
+            digest[:16],
+        )
+
+    def _load(self) -> None:
+        with open(self.path, "r", encoding="utf-8") as f:
+            for line in f:
+                try:
+                    entry = json.loads(line)
+                except json.JSONDecodeError:
+                    # 进程中途崩溃时最后一行可能不完整
+                    continue
+                self.done.add(
+                    (
+                        entry["file"],
+                        entry["start_line"],
+                        entry["end_line"],
+                        entry["hash"],
+                    )
+                )
+
+    def is_done(
+        self, filename: str, comment: dict[str, Any], context: str = ""
+    ) -> bool:
+        if self._key(filename, comment, context) in self.done:
+            self.skipped += 1
+            return True
+        return False
+
+    def record(
+        self, filename: str, comments: list[tuple[dict[str, Any], str]]
+    ) -> None:
+        """
+        记录一个文件中已完成分析的注释，并立即刷新到磁盘
+
+        Args:
+            filename: 文件路径
+            comments: 已得到分析结果的 (注释, 分析时的上下文)
+        """
+        for comment, context in comments:
+            key = self._key(filename, comment, context)
+            self.done.add(key)
+            entry = dict(zip(("file", "start_line", "end_line", "hash"), key))
+            self.file.write(json.dumps(entry, ensure_ascii=False) + "\n")
+        self.file.flush()
+
+    def close(self) -> None:
+        self.file.close()
+        if self.skipped:
+            logger.info(f"Skipped {self.skipped} comments already in {self.path}")
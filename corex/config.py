@@ -7,7 +7,103 @@ LLM_KEYS_PATH = LLM_CONFIG_DIR / "llm_keys.yaml"
 PROMPT_TEMPLATES_DIR = ROOT_DIR / "prompts"
 LANGUAGE_SUFFIX_MAP = {
     "python": [".py"],
-    "c/c++": [".cpp", ".c", ".h", ".hpp", ".cc", ".cxx"],
+    "cpp": [".cpp", ".c", ".h", ".hpp", ".cc", ".cxx"],
     "cuda": [".cu", ".cuh"],
     "objective-c": [".m", ".mm"],
 }
+# language="auto" 时按后缀为每个文件选择语言
+AUTO_LANGUAGE = "auto"
+SUFFIX_LANGUAGE_MAP = {
+    suffix: language
+    for language, suffixes in LANGUAGE_SUFFIX_MAP.items()
+    for suffix in suffixes
+}
+# 语言到 tree-sitter 语法的映射：CUDA 使用 C++ 语法（解析前屏蔽 CUDA 限定符）
+LANGUAGE_GRAMMAR_MAP = {
+    "python": "python",
+    "cpp": "cpp",
+    "cuda": "cpp",
+    "objective-c": "objc",
+}
+# 同时在途的 LLM 请求数上限（可在 model_config.yaml 中按模型覆盖）
+DEFAULT_MAX_CONCURRENCY = 8
+# 分析结果缓存（注释 + 提示词版本 + 模型 + 配置 -> LLM 响应）
+CACHE_DIR = ROOT_DIR / ".corex_cache"
+ANALYSIS_CACHE_PATH = CACHE_DIR / "analysis.sqlite"
+# 提取结果索引（路径 + mtime + 大小 + 内容哈希 + 提取器签名 -> 提取结果），
+# 提取结果的格式变化时递增版本号，旧索引自然失效
+EXTRACTION_INDEX_PATH = CACHE_DIR / "extraction.sqlite"
+EXTRACTION_INDEX_VERSION = 4
+# 流水线各阶段之间队列的容量（以文件为单位），决定背压与峰值内存
+DEFAULT_PIPELINE_DEPTH = 32
+# 多进程提取时每个 worker 最多提前查询索引、提交解析的文件数，限制在途结果的内存
+PARSE_LOOKAHEAD_PER_WORKER = 8
+# 各分析模式单次请求的输出 token 上限：结论为紧凑 JSON，Normal 只返回类型；
+# 批量请求按 case 数线性放宽
+VERDICT_MAX_TOKENS = 256
+CONTEXT_VERDICT_MAX_TOKENS = 384
+BATCH_CASE_MAX_TOKENS = 160
+# watch 模式下两次轮询文件变化的间隔（秒）
+DEFAULT_WATCH_INTERVAL = 1.0
+# AnalyzerWithContext 中单条注释上下文的 token 预算
+DEFAULT_CONTEXT_TOKENS = 2048
+# 构建上下文时缓存作用域分词结果的最近文件数，同一文件的注释共用一次分词
+CONTEXT_CACHE_FILES = 8
+# KeywordExtractor 默认匹配的关键词：待办/临时方案标记与容易出错的底层写法
+DEFAULT_KEYWORDS = (
+    "TODO",
+    "FIXME",
+    "HACK",
+    "XXX",
+    "unsafe",
+    "volatile",
+    "__syncthreads",
+)
+# 目录扫描时在任意层级直接跳过的目录（版本库、缓存、虚拟环境与依赖安装目录）
+DEFAULT_EXCLUDE_DIRS = (
+    ".git",
+    ".hg",
+    ".svn",
+    ".corex_cache",
+    ".tox",
+    ".venv",
+    "venv",
+    "__pycache__",
+    "node_modules",
+)
+# 只在扫描根目录下跳过的目录（构建产物与第三方代码）；这些名称在更深的层级
+# 常是正常的源码包（如 src/build/），不做剪枝
+DEFAULT_ROOT_EXCLUDE_DIRS = (
+    "build",
+    "dist",
+    "third_party",
+    "vendor",
+)
+# 各层目录中读取的忽略文件，语法同 .gitignore
+IGNORE_FILES = (".gitignore", ".corexignore")
+# 超过该大小（字节）的文件不扫描，通常是生成代码或数据
+DEFAULT_MAX_FILE_SIZE = 4 * 1024 * 1024
+# 优先级调度的风险打分：注释中出现的词及其权重（不区分大小写，多个词累加）
+RISK_KEYWORDS = {
+    "FIXME": 3.0,
+    "BUG": 3.0,
+    "HACK": 2.5,
+    "XXX": 2.0,
+    "TODO": 1.5,
+    "workaround": 2.0,
+    "not thread-safe": 4.0,
+    "thread safe": 2.0,
+    "race": 3.0,
+    "deadlock": 3.0,
+    "overflow": 2.5,
+    "undefined behavior": 3.0,
+    "deprecated": 1.5,
+    "temporary": 1.5,
+    "must": 1.0,
+}
+# 注释位于 CUDA kernel 中的加分
+KERNEL_RISK_WEIGHT = 2.0
+# 注释比其描述的代码旧（git blame）时的加分上限，按相差天数线性增长，一年封顶
+STALENESS_RISK_WEIGHT = 3.0
+# 优先级调度时每次取出的高分注释数，窗口内同一文件的注释合并提交以保留批量请求
+DEFAULT_PRIORITY_WINDOW = 64
@@ -0,0 +1,176 @@
+import asyncio
+from typing import Optional, Union
+
+from loguru import logger
+
+from .analyzer import Analyzer
+from .cache import AnalysisCache
+from .metrics import METRICS
+from .scheduler import Budget
+from .utils.text import normalize_comment
+from .verdict import parse_verdict
+
+
+class Dispatcher:
+    """
+    并发分析调度器
+
+    所有请求共享一个信号量，保证同时在途的 LLM 请求数不超过 max_concurrency；
+    速率限制由 LLM 客户端根据 model_config.yaml 中的 rate_limit 负责。
+    配置了 cache 时，命中的注释不再发送请求，新结果在返回后写入缓存。
+    开启 dedup 时，本次运行中归一化后相同的注释只分析一次，结论分发给所有出现位置。
+    分析器的后续请求（级联确认）在释放名额之后提交，并同样计入 budget。
+    """
+
+    def __init__(
+        self,
+        analyzer: Analyzer,
+        max_concurrency: int,
+        cache: Optional[AnalysisCache] = None,
+        dedup: bool = True,
+        budget: Optional[Budget] = None,
+    ):
+        if max_concurrency < 1:
+            raise ValueError(f"max_concurrency must be >= 1, got {max_concurrency}")
+        self.analyzer = analyzer
+        self.max_concurrency = max_concurrency
+        self.semaphore = asyncio.Semaphore(max_concurrency)
+        self.cache = cache
+        self.dedup = dedup
+        # 后续请求的预算检查，每个请求提交前调用一次
+        self._admit = budget.admit if budget is not None else None
+        # 归一化 key -> (负责分析该注释的批次任务, 注释在批次中的位置)；
+        # 批次完成后只保留结论文本，不再持有任务及其整个批次的结果
+        self.inflight: dict[str, Union[tuple[asyncio.Task, int], str]] = {}
+        self.duplicates = 0
+        self.failures = 0
+
+    def dedup_key(self, comment: str, context: str = "") -> Optional[str]:
+        if not self.dedup:
+            return None
+        return self.analyzer.cache_key(normalize_comment(comment), context)
+
+    def is_submitted(self, key: Optional[str]) -> bool:
+        """相同注释是否已在本次运行中提交过"""
+        return key is not None and key in self.inflight
+
+    def shared_result(self, key: str) -> Union[tuple[asyncio.Task, int], str]:
+        """
+        取得重复注释复用的分析结果
+
+        Returns:
+            已完成时为结论文本，否则为 (负责分析的批次任务, 批次内位置)
+        """
+        self.duplicates += 1
+        METRICS.counter(
+            "comments_deduplicated", "Comments reusing the verdict of a duplicate"
+        ).inc()
+        return self.inflight[key]
+
+    def register_batch(self, task: asyncio.Task, keys: list[Optional[str]]) -> None:
+        """登记批次中每条注释的归一化 key，供后续重复注释复用结果"""
+        for position, key in enumerate(keys):
+            if key is not None:
+                self.inflight.setdefault(key, (task, position))
+        task.add_done_callback(lambda done: self._resolve(done, keys))
+
+    def _resolve(self, task: asyncio.Task, keys: list[Optional[str]]) -> None:
+        """批次完成后把登记项换成结论文本；没有结论的注释移除登记，之后的重复注释重新提交"""
+        failed = task.cancelled() or task.exception() is not None
+        responses = [None] * len(keys) if failed else task.result()
+        for position, (key, response) in enumerate(zip(keys, responses)):
+            if key is None or self.inflight.get(key) != (task, position):
+                continue
+            if response is None:
+                del self.inflight[key]
+            else:
+                self.inflight[key] = response
+
+    def log_stats(self) -> None:
+        if self.failures:
+            logger.warning(
+                f"{self.failures} comments failed to analyze; "
+                "rerun with --resume to retry them"
+            )
+        if self.dedup:
+            logger.info(
+                f"Deduplicated {self.duplicates} comments "
+                f"({len(self.inflight)} unique comments analyzed)"
+            )
+
+    def lookup(self, comment: str, context: str = "") -> Optional[str]:
+        """
+        查询缓存中已有的分析结果，未配置缓存或未命中时返回 None
+        """
+        if self.cache is None:
+            return None
+        response = self.cache.get(self.analyzer.cache_key(comment, context))
+        if response is None:
+            METRICS.counter("cache_misses", "Analysis cache misses").inc()
+        else:
+            METRICS.counter("cache_hits", "Analysis cache hits").inc()
+        return response
+
+    async def analyze(self, comment: str, context: str = "") -> Optional[str]:
+        """
+        在并发上限内分析单条注释
+
+        Args:
+            comment: 注释文本
+            context: 注释所在的代码上下文
+
+        Returns:
+            LLM 的分析结果，未得到结论时为 None
+        """
+        cached = self.lookup(comment, context)
+        if cached is not None:
+            return cached
+        async with self.semaphore:
+            responses = await self.analyzer.aprimary_batch([comment], [context])
+        (response,) = await self.analyzer.aescalate(
+            [comment], [context], responses, self._admit
+        )
+        if response is not None:
+            self._store(comment, context, response)
+        return response
+
+    async def analyze_batch(
+        self, comments: list[str], contexts: list[str]
+    ) -> list[Optional[str]]:
+        """
+        在并发上限内分析一个批次的注释，整个批次只占用一个请求名额
+
+        请求失败不会中断整个扫描：记录错误后该批次结果为 None，
+        这些注释不会写入检查点，--resume 时会重新分析。
+
+        Returns:
+            与输入注释一一对应的分析结果，失败时为 None
+        """
+        try:
+            async with self.semaphore:
+                with METRICS.time("analysis_seconds"):
+                    responses = await self.analyzer.aprimary_batch(comments, contexts)
+            responses = await self.analyzer.aescalate(
+                comments, contexts, responses, self._admit
+            )
+        except Exception as e:
+            self.failures += len(comments)
+            METRICS.counter("analysis_failures", "Comments failed to analyze").inc(
+                len(comments)
+            )
+            logger.error(f"Failed to analyze {len(comments)} comments: {e!s}")
+            return [None] * len(comments)
+        for comment, context, response in zip(comments, contexts, responses):
+            if response is not None:
+                self._store(comment, context, response)
+        return responses
+
+    def _store(self, comment: str, context: str, response: str) -> None:
+        # 无法解析的响应多半是一次偶然的坏输出，不写入缓存，下次运行重新请求
+        if self.cache is None or parse_verdict(response) is None:
+            return
+        self.cache.put(
+            self.analyzer.cache_key(comment, context),
+            response,
+            self.analyzer.llms.model_id,
+        )
@@ -1,12 +1,98 @@
+import itertools
 import json
+import mmap
+import os
+import re
+import time
 from abc import ABC, abstractmethod
+from collections import deque
+from concurrent.futures import Future, ProcessPoolExecutor
+from dataclasses import dataclass
 from pathlib import Path
-from typing import Any, List
+from typing import Any, Callable, Iterator, List, Optional, Sequence
 
 from loguru import logger
 from tree_sitter_languages import get_parser
 
-from .config import LANGUAGE_SUFFIX_MAP
+from .cache import ExtractionIndex
+from .config import (
+    AUTO_LANGUAGE,
+    DEFAULT_KEYWORDS,
+    LANGUAGE_GRAMMAR_MAP,
+    LANGUAGE_SUFFIX_MAP,
+    PARSE_LOOKAHEAD_PER_WORKER,
+    SUFFIX_LANGUAGE_MAP,
+)
+from .metrics import METRICS
+from .utils.source import SourceFile
+from .utils.walk import PathFilter, WalkCache, walk_files
+
+# 各语法中作为注释上下文的作用域节点类型及其种类
+_C_FAMILY_SCOPES = {
+    "function_definition": "function",
+    "class_specifier": "class",
+    "struct_specifier": "struct",
+    "union_specifier": "union",
+    "enum_specifier": "enum",
+    "namespace_definition": "namespace",
+}
+SCOPE_GRAMMARS = {
+    "python": {"function_definition": "function", "class_definition": "class"},
+    "cpp": _C_FAMILY_SCOPES,
+    "objc": {
+        **_C_FAMILY_SCOPES,
+        "class_interface": "class",
+        "class_implementation": "class",
+        "category_interface": "category",
+        "category_implementation": "category",
+        "protocol_declaration": "protocol",
+        "method_definition": "method",
+    },
+}
+FUNCTION_KINDS = ("function", "kernel", "method")
+
+# C/C++ 声明符中可以包裹函数名的节点，逐层沿 declarator 字段向内查找
+_DECLARATOR_WRAPPERS = (
+    "function_declarator",
+    "pointer_declarator",
+    "reference_declarator",
+    "parenthesized_declarator",
+    "attributed_declarator",
+)
+_DECLARATOR_NAMES = (
+    "identifier",
+    "field_identifier",
+    "qualified_identifier",
+    "destructor_name",
+    "operator_name",
+    "template_function",
+)
+
+# tree-sitter-cpp 不认识的 CUDA 扩展，解析前替换为等长空格以保持字节偏移
+_CUDA_MASK = re.compile(
+    rb"\b__(?:global|device|host|forceinline|noinline|shared|constant|managed"
+    rb"|restrict)__\b|\b__launch_bounds__\s*\([^)]*\)|<<<[^;\n]*?>>>"
+)
+_NOT_NEWLINE = re.compile(rb"[^\n]")
+
+
+def mask_cuda(source: bytes) -> bytes:
+    """
+    将 CUDA 限定符与 <<<...>>> 启动配置替换为空格，字节偏移与行号不变
+
+    启动配置不跨语句也不跨行，避免注释或字符串中落单的 <<< 一直匹配到后文的 >>>；
+    跨行的 __launch_bounds__ 保留其中的换行。
+    """
+    return _CUDA_MASK.sub(lambda m: _NOT_NEWLINE.sub(b" ", m.group(0)), source)
+
+
+@dataclass
+class RetainedTree:
+    """watch 模式下保留的语法树，以及解析它时交给 parser 的字节"""
+
+    grammar: str
+    source: bytes
+    tree: Any
 
 
 class Extractor(ABC):
@@ -17,25 +103,71 @@ class Extractor(ABC):
     def parse_file(self, file_path: Path) -> List[dict[str, Any]]:
         raise NotImplementedError()
 
+    def collect_files(
+        self, file_path: Path, walk_cache: Optional[WalkCache] = None
+    ) -> List[Path]:
+        return [Path(file_path)]
 
-class KeywordExtractor(Extractor):
-    """关键词提取器 - 占位类"""
+    def parse_files(self, file_list: List[Path]) -> List[dict[str, Any]]:
+        return list(self.iter_parse_files(file_list))
 
-    def __init__(self, language: str):
-        super().__init__(language=language)
+    def iter_parse_files(self, file_list: List[Path]) -> Iterator[dict[str, Any]]:
+        for file in file_list:
+            yield from self.parse_file(file)
 
-    def parse_file(self, file_path: Path) -> List[dict[str, Any]]:  # type: ignore
-        pass
+    def iter_parse_file(self, file_path: Path) -> Iterator[dict[str, Any]]:
+        """流式产出 file_path（文件或目录）下每个文件的提取结果"""
+        return self.iter_parse_files(self.collect_files(file_path))
+
+    def keep_trees(self) -> None:
+        """保留解析状态以便文件修改后增量解析（watch 模式），默认每次完整解析"""
+
+    def forget(self, file: Path) -> None:
+        """丢弃文件的解析状态（文件被删除时）"""
+
+    def close(self) -> None:
+        """释放提取器持有的资源"""
 
 
 class CommentExtractor(Extractor):
     """多语言注释提取器"""
 
-    def __init__(self, language: str):
+    def __init__(
+        self,
+        language: str,
+        workers: int = 1,
+        path_filter: Optional[PathFilter] = None,
+        index: Optional[ExtractionIndex] = None,
+    ):
+        """
+        Args:
+            language: 源码语言，"auto" 表示按后缀为每个文件选择语言，一次扫描整个仓库
+            workers: 解析进程数，1 表示在当前进程中顺序解析，0 表示使用全部 CPU
+            path_filter: 目录扫描的过滤条件，None 时使用默认条件
+            index: 提取结果索引，未变化的文件直接读取上次的结果
+        """
         super().__init__(language=language)
-        self.parser = get_parser(self.language)
-        self.source_code = b""
-        self.source_lines = []
+        self.workers = workers if workers > 0 else (os.cpu_count() or 1)
+        self.path_filter = path_filter
+        self.index = index
+        # 语法名 -> parser，language="auto" 时按需创建，每个进程各自持有
+        self._parsers: dict[str, Any] = {}
+        # 当前文件的语言及对应的语法、parser 与作用域类型
+        self.file_language = language
+        self.grammar = ""
+        self.parser = None
+        self.scope_types: dict[str, str] = {}
+        if language != AUTO_LANGUAGE:
+            self._select_language(language)
+        # 当前文件的源码缓冲区（bytes 或 mmap），文本统一经 self.source 解码
+        self.source: Optional[SourceFile] = None
+        self.source_code: bytes | mmap.mmap = b""
+        # 当前文件的作用域表：每个函数/类只提取一次，注释通过 scope_id 引用
+        self.scopes: list[dict[str, Any]] = []
+        # 遍历过程中由外到内的作用域栈，元素为 [节点, scope_id 或 None]
+        self._scope_stack: list[list[Any]] = []
+        # 文件路径 -> 上次解析的语法树，None 表示不保留（见 keep_trees）
+        self.trees: Optional[dict[str, RetainedTree]] = None
 
     def parse_file(self, file_path: Path) -> List[dict[str, Any]]:
         """
@@ -47,37 +179,300 @@ class CommentExtractor(Extractor):
         Returns:
             包含注释信息的字典
         """
+        return self.parse_files(self.collect_files(file_path))
+
+    def collect_files(
+        self, file_path: Path, walk_cache: Optional[WalkCache] = None
+    ) -> List[Path]:
+        """
+        收集待解析的文件，目录会递归查找当前语言对应后缀的文件，
+        并按 path_filter 跳过忽略的目录、过大的文件与生成文件
+
+        Args:
+            file_path: 文件或目录路径
+            walk_cache: 跨多次收集复用的目录列表与文件判定（watch 模式）
+
+        Returns:
+            文件路径列表
+        """
         file_path = Path(file_path)
-        if file_path.is_dir():
-            suffix = LANGUAGE_SUFFIX_MAP.get(self.language, [])
-            if not suffix:
-                raise ValueError(f"Unsupported language: {self.language}")
+        if not file_path.is_dir():
+            return [file_path]
 
-            file_list = [p for ext in suffix for p in file_path.rglob(f"*{ext}")]
+        if self.language == AUTO_LANGUAGE:
+            suffix = list(SUFFIX_LANGUAGE_MAP)
         else:
-            file_list = [file_path]
+            suffix = LANGUAGE_SUFFIX_MAP.get(self.language, [])
+        if not suffix:
+            raise ValueError(f"Unsupported language: {self.language}")
+        return list(walk_files(file_path, suffix, self.path_filter, walk_cache))
 
-        all_comments = []
-        for file in file_list:
-            self.source_code = file.read_bytes()
-            self.source_lines = self.source_code.decode("utf-8").split("\n")
+    def parse_files(self, file_list: List[Path]) -> List[dict[str, Any]]:
+        """
+        解析文件列表并提取注释信息
+
+        Args:
+            file_list: 文件路径列表
+
+        Returns:
+            每个文件一个注释信息字典，顺序与 file_list 一致
+        """
+        return list(self.iter_parse_files(file_list))
+
+    def iter_parse_files(self, file_list: List[Path]) -> Iterator[dict[str, Any]]:
+        """
+        逐个产出文件的注释信息；workers > 1 时按文件分发到进程池并行解析，
+        每个 worker 进程持有独立的 tree-sitter parser，结果按 file_list 顺序流式返回
+
+        索引在顺序遍历中逐个查询，命中的结果不会提前全部读入内存；多进程时最多
+        提前 PARSE_LOOKAHEAD_PER_WORKER * workers 个文件，其中未命中的交给进程池
+
+        Args:
+            file_list: 文件路径列表
 
-            tree = self.parser.parse(self.source_code)
-            root_node = tree.root_node
+        Yields:
+            单个文件的注释信息字典
+        """
+        parse_seconds = METRICS.histogram(
+            "parse_seconds", "Time to parse one file and extract its comments"
+        )
+        files_parsed = METRICS.counter("files_parsed", "Source files parsed")
+        comments_extracted = METRICS.counter(
+            "comments_extracted", "Comments extracted from source files"
+        )
+        signature = self.signature() if self.index is not None else ""
+        for file, result, parsed in self._iter_results(file_list, signature):
+            if parsed:
+                # 耗时在解析所在的进程中测量，随结果带回主进程汇总
+                parse_seconds.observe(result.get("parse_seconds", 0.0))
+                files_parsed.inc()
+                if "error" in result:
+                    METRICS.counter(
+                        "files_failed", "Files skipped on read/parse errors"
+                    ).inc()
+                if self.index is not None:
+                    self.index.put(file, signature, result)
+            comments_extracted.inc(result.get("total_comments", 0))
+            yield result
+
+    def keep_trees(self) -> None:
+        """
+        保留每个文件的语法树，文件再次解析时在旧树上做增量解析（watch 模式）
 
-            comments = []
-            self._extract_comments(root_node, comments)
-            dic = {
+        语法树保存在当前进程中，因此之后的解析都在当前进程中顺序进行。
+        """
+        if self.trees is None:
+            self.trees = {}
+
+    def forget(self, file: Path) -> None:
+        """丢弃文件保留的语法树（文件被删除时）"""
+        if self.trees is not None:
+            self.trees.pop(str(file), None)
+
+    def signature(self) -> str:
+        """提取器签名，决定索引中的结果能否复用"""
+        return ExtractionIndex.make_signature(
+            type(self).__name__, self.language, self._worker_kwargs()
+        )
+
+    def close(self) -> None:
+        if self.index is not None:
+            self.index.log_stats()
+            self.index.close()
+
+    def _lookup(self, file: Path, signature: str) -> Optional[dict[str, Any]]:
+        if self.index is None:
+            return None
+        return self.index.get(file, signature)
+
+    def _iter_results(
+        self, file_list: List[Path], signature: str
+    ) -> Iterator[tuple[Path, dict[str, Any], bool]]:
+        """
+        按 file_list 顺序产出 (文件, 提取结果, 是否为本次解析)
+        """
+        if self.workers <= 1 or len(file_list) <= 1 or self.trees is not None:
+            for file in file_list:
+                if (result := self._lookup(file, signature)) is not None:
+                    yield file, result, False
+                else:
+                    yield file, self._parse_single(file), True
+            return
+
+        workers = min(self.workers, len(file_list))
+        with ProcessPoolExecutor(
+            max_workers=workers,
+            initializer=_init_worker,
+            initargs=(type(self), self.language, self._worker_kwargs()),
+        ) as executor:
+
+            def submit(file: Path) -> tuple[Path, Any]:
+                result = self._lookup(file, signature)
+                if result is None:
+                    return file, executor.submit(_parse_in_worker, file)
+                return file, result
+
+            # 有界的预读窗口：取出一个结果就补充一个文件，进程池始终有活可干，
+            # 而已完成、未被消费的结果不超过窗口大小
+            files = iter(file_list)
+            lookahead = workers * PARSE_LOOKAHEAD_PER_WORKER
+            window: deque[tuple[Path, Any]] = deque(
+                submit(file) for file in itertools.islice(files, lookahead)
+            )
+            while window:
+                file, pending = window.popleft()
+                if (following := next(files, None)) is not None:
+                    window.append(submit(following))
+                if isinstance(pending, Future):
+                    yield file, pending.result(), True
+                else:
+                    yield file, pending, False
+
+    def _parse_single(self, file: Path) -> dict[str, Any]:
+        """
+        解析单个文件并提取注释信息
+
+        Args:
+            file: 文件路径
+
+        Returns:
+            注释信息字典
+        """
+        start = time.perf_counter()
+        self.scopes = []
+        self._scope_stack = []
+        try:
+            if self.language == AUTO_LANGUAGE:
+                # 后缀无法识别时出错记录不能沿用上一个文件的语言
+                self.file_language = "unknown"
+                self._select_language(language_of(file))
+            self.source = SourceFile(file)
+            self.source_code = self.source.data
+            content_hash = self.source.digest()
+            comments = self._collect_comments()
+        except (OSError, ValueError, RuntimeError) as e:
+            # 单个文件读取或解析失败时跳过，不中断整个扫描
+            logger.warning(f"Skipping {file}: {type(e).__name__}: {e!s}")
+            return {
                 "file": str(file),
-                "total_comments": len(comments),
-                "comments": comments,
+                "language": self.file_language,
+                "total_comments": 0,
+                "comments": [],
+                "scopes": [],
+                "parse_seconds": time.perf_counter() - start,
+                "error": f"{type(e).__name__}: {e!s}",
             }
-            all_comments.append(dic)
-        return all_comments
+        finally:
+            if self.source is not None:
+                self.source.close()
+            self.source = None
+            self.source_code = b""
+        return {
+            "file": str(file),
+            "language": self.file_language,
+            "total_comments": len(comments),
+            "comments": comments,
+            "scopes": self.scopes,
+            "content_hash": content_hash,
+            "parse_seconds": time.perf_counter() - start,
+        }
 
-    def _extract_comments(self, node, comments: list) -> None:
+    def _select_language(self, language: str) -> None:
+        """切换到 language 对应的语法，parser 在首次使用某个语法时创建"""
+        self.file_language = language
+        self.grammar = LANGUAGE_GRAMMAR_MAP.get(language, language)
+        if self.grammar not in self._parsers:
+            self._parsers[self.grammar] = get_parser(self.grammar)
+        self.parser = self._parsers[self.grammar]
+        self.scope_types = SCOPE_GRAMMARS.get(self.grammar, SCOPE_GRAMMARS["python"])
+
+    def _parse_tree(self):
+        """解析当前源码，返回语法树根节点"""
+        # 文本始终从原始字节中截取，屏蔽只影响语法分析
+        parse_source = self.source_code
+        if self.file_language == "cuda":
+            parse_source = mask_cuda(self.source_code)
+        if self.trees is None:
+            # 不让语法树持有源码引用，解析完成后即可关闭 mmap
+            return self.parser.parse(parse_source, keep_text=False).root_node
+
+        # 保留语法树时需要留一份字节，下次与新内容比较得到编辑区间
+        parse_source = bytes(parse_source)
+        path = str(self.source.path)
+        retained = self.trees.get(path)
+        if retained is not None and retained.grammar == self.grammar:
+            retained.tree.edit(**input_edit(retained.source, parse_source))
+            tree = self.parser.parse(parse_source, retained.tree, keep_text=False)
+            METRICS.counter(
+                "files_reparsed_incrementally", "Files reparsed from a retained tree"
+            ).inc()
+        else:
+            tree = self.parser.parse(parse_source, keep_text=False)
+        self.trees[path] = RetainedTree(self.grammar, parse_source, tree)
+        return tree.root_node
+
+    def _collect_comments(self) -> list[dict[str, Any]]:
+        """提取当前源码中的注释记录，子类可覆盖以产出其他类型的记录"""
+        comments = []
+        root_node = self._parse_tree()
+        self._extract_comments(root_node, comments)
+        mark_header(root_node, comments)
+        return comments
+
+    def _worker_kwargs(self) -> dict[str, Any]:
+        """在 worker 进程中重建提取器所需的额外构造参数"""
+        return {}
+
+    def _extract_comments(self, root_node, comments: list) -> None:
+        """
+        使用 TreeCursor 迭代遍历语法树，一次遍历提取所有注释
+
+        遍历时维护作用域栈，注释的上下文直接取栈顶，无需逐个回溯父节点；
+        迭代实现也不受 Python 递归深度限制。
+
+        Args:
+            root_node: tree-sitter 根节点
+            comments: 注释列表
         """
-        递归提取所有注释节点
+        cursor = root_node.walk()
+        while True:
+            node = cursor.node
+            self._visit(node, comments)
+
+            is_scope = self._is_scope(node)
+            if is_scope:
+                self._scope_stack.append([node, None])
+            if cursor.goto_first_child():
+                continue
+            if is_scope:
+                self._scope_stack.pop()
+
+            # 回溯到下一个兄弟节点，离开的作用域节点出栈
+            while not cursor.goto_next_sibling():
+                if not cursor.goto_parent():
+                    return
+                if self._is_scope(cursor.node):
+                    self._scope_stack.pop()
+
+    def _is_scope(self, node) -> bool:
+        """
+        判断节点是否为作用域；C/C++ 的 class/struct/enum 仅在带有定义体时才算
+        （排除前置声明与 `struct stat st;` 这类用法）
+        """
+        kind = self.scope_types.get(node.type)
+        if kind is None:
+            return False
+        if node.type.endswith("_specifier"):
+            return node.child_by_field_name("body") is not None
+        return True
+
+    def _text(self, node) -> str:
+        """从原始源码中截取节点文本"""
+        return self.source.decode(node.start_byte, node.end_byte)
+
+    def _visit(self, node, comments: list) -> None:
+        """
+        处理单个节点，若为注释或 docstring 则记录
 
         Args:
             node: tree-sitter 节点
@@ -97,10 +492,6 @@ class CommentExtractor(Extractor):
                     comment_info = self._extract_docstring_info(string_node, node)
                     comments.append(comment_info)
 
-        # 递归处理子节点
-        for child in node.children:
-            self._extract_comments(child, comments)
-
     def _is_docstring(self, expr_stmt_node) -> bool:
         """
         判断表达式语句是否为 docstring
@@ -147,17 +538,14 @@ class CommentExtractor(Extractor):
         """
         start_line = node.start_point[0] + 1  # tree-sitter 行号从 0 开始
         end_line = node.end_point[0] + 1
-        comment_text = node.text.decode("utf-8")
-
-        # 查找所在的函数或类
-        context = self._find_context(node)
+        comment_text = self._text(node)
 
         return {
             "type": "comment",
             "text": comment_text,
             "start_line": start_line,
             "end_line": end_line,
-            "context": context,
+            "scope_id": self._current_scope(),
         }
 
     def _extract_docstring_info(self, string_node, expr_stmt_node) -> dict[str, Any]:
@@ -173,116 +561,171 @@ class CommentExtractor(Extractor):
         """
         start_line = string_node.start_point[0] + 1
         end_line = string_node.end_point[0] + 1
-        docstring_text = string_node.text.decode("utf-8")
-
-        # 查找所在的函数或类
-        context = self._find_context(expr_stmt_node)
+        docstring_text = self._text(string_node)
 
         return {
             "type": "docstring",
             "text": docstring_text,
             "start_line": start_line,
             "end_line": end_line,
-            "context": context,
+            "scope_id": self._current_scope(),
         }
 
-    def _find_context(self, node) -> dict[str, Any]:
+    def _current_scope(self) -> Optional[int]:
         """
-        查找节点所在的上下文（函数或类）
+        获取当前遍历位置最内层上下文（函数或类）的作用域 id
 
-        Args:
-            node: tree-sitter 节点
+        作用域只在首次被注释引用时提取并登记（由外到内），
+        没有注释的函数/类不会进入作用域表。
 
         Returns:
-            上下文信息字典
+            作用域 id，模块级返回 None
         """
-        current = node.parent
-        context_stack = []
-
-        while current is not None:
-            if current.type == "function_definition":
-                func_info = self._extract_function_info(current)
-                context_stack.append(func_info)
-            elif current.type == "class_definition":
-                class_info = self._extract_class_info(current)
-                context_stack.append(class_info)
-            current = current.parent
-
-        # 反转堆栈，使得最外层的上下文在前
-        context_stack.reverse()
-
-        if not context_stack:
-            return {"type": "module", "name": None}
-
-        return (
-            context_stack[-1] if len(context_stack) == 1 else {"chain": context_stack}
-        )
+        parent = None
+        for entry in self._scope_stack:
+            if entry[1] is None:
+                scope_node = entry[0]
+                if self.scope_types[scope_node.type] in FUNCTION_KINDS:
+                    info = self._extract_function_info(scope_node)
+                else:
+                    info = self._extract_class_info(scope_node)
+                info["id"] = len(self.scopes)
+                info["parent"] = parent
+                self.scopes.append(info)
+                entry[1] = info["id"]
+            parent = entry[1]
+        return parent
 
     def _extract_function_info(self, func_node) -> dict[str, Any]:
         """
         提取函数信息
 
         Args:
-            func_node: function_definition 节点
+            func_node: function_definition / method_definition 节点
 
         Returns:
             函数信息字典
         """
         func_name = None
         params = []
+        kind = self.scope_types[func_node.type]
 
-        for child in func_node.children:
-            if child.type == "identifier":
-                func_name = child.text.decode("utf-8")
-            elif child.type == "parameters":
-                params = self._extract_parameters(child)
-
-        start_line = func_node.start_point[0] + 1
-        end_line = func_node.end_point[0] + 1
+        declarator = func_node.child_by_field_name("declarator")
+        if declarator is not None:
+            # C/C++: 名称与参数位于 declarator -> function_declarator 中
+            func_name, params = self._extract_declarator_info(declarator)
+            # CUDA 限定符在解析前已被屏蔽，需从原始源码中识别 kernel
+            prefix = self.source_code[func_node.start_byte : declarator.start_byte]
+            if b"__global__" in prefix:
+                kind = "kernel"
+        else:
+            for child in func_node.children:
+                if child.type == "identifier" and func_name is None:
+                    func_name = self._text(child)
+                elif child.type == "parameters":
+                    params = self._extract_parameters(child)
 
-        # 提取函数代码
-        func_code = "\n".join(self.source_lines[start_line - 1 : end_line])
+        # 只记录行区间：嵌套作用域保存各自的源码会使记录随嵌套深度成倍增长，
+        # 需要代码时由 read_scope_code 从源文件截取
+        start_line, end_line = self._scope_lines(func_node)
 
         return {
-            "type": "function",
+            "type": kind,
             "name": func_name,
             "parameters": params,
             "start_line": start_line,
             "end_line": end_line,
-            "code": func_code,
         }
 
     def _extract_class_info(self, class_node) -> dict[str, Any]:
         """
-        提取类信息
+        提取类信息（Python class、C++ class/struct/namespace、Objective-C 接口等）
 
         Args:
-            class_node: class_definition 节点
+            class_node: 作用域节点
 
         Returns:
             类信息字典
         """
         class_name = None
 
-        for child in class_node.children:
-            if child.type == "identifier":
-                class_name = child.text.decode("utf-8")
-                break
-
-        start_line = class_node.start_point[0] + 1
-        end_line = class_node.end_point[0] + 1
+        name_node = class_node.child_by_field_name("name")
+        if name_node is not None:
+            class_name = self._text(name_node)
+        else:
+            for child in class_node.children:
+                if child.type in ("identifier", "type_identifier"):
+                    class_name = self._text(child)
+                    break
 
-        # 提取类代码
-        class_code = "\n".join(self.source_lines[start_line - 1 : end_line])
+        start_line, end_line = self._scope_lines(class_node)
 
         return {
-            "type": "class",
+            "type": self.scope_types[class_node.type],
             "name": class_name,
             "start_line": start_line,
             "end_line": end_line,
-            "code": class_code,
         }
 
+    def _scope_lines(self, scope_node) -> tuple[int, int]:
+        """
+        作用域的起止行号，C++ 模板连同 template<...> 声明一起计入
+        """
+        start_node = scope_node
+        while start_node.parent is not None and (
+            start_node.parent.type == "template_declaration"
+        ):
+            start_node = start_node.parent
+        return start_node.start_point[0] + 1, scope_node.end_point[0] + 1
+
+    def _extract_declarator_info(self, declarator) -> tuple[Optional[str], list[str]]:
+        """
+        从 C/C++ 函数声明符中提取函数名与参数名
+
+        Args:
+            declarator: function_definition 的 declarator 字段
+
+        Returns:
+            (函数名, 参数列表)
+        """
+        name, params = None, []
+        node = declarator
+        while node is not None and node.type in _DECLARATOR_WRAPPERS:
+            if node.type == "function_declarator":
+                param_list = node.child_by_field_name("parameters")
+                if param_list is not None:
+                    params = self._extract_c_parameters(param_list)
+            node = node.child_by_field_name("declarator")
+        if node is not None and node.type in _DECLARATOR_NAMES:
+            name = self._text(node)
+        return name, params
+
+    def _extract_c_parameters(self, param_list) -> list[str]:
+        """
+        提取 C/C++ 参数列表中的参数名，未命名参数会被跳过
+
+        Args:
+            param_list: parameter_list 节点
+
+        Returns:
+            参数列表
+        """
+        params = []
+        for child in param_list.named_children:
+            node = child.child_by_field_name("declarator")
+            # 沿 pointer/reference/array 声明符向内找到标识符
+            while node is not None and node.type != "identifier":
+                inner = node.child_by_field_name("declarator")
+                if inner is None:
+                    inner = next(
+                        (c for c in node.named_children if c.type == "identifier"),
+                        None,
+                    )
+                node = inner
+            if node is not None:
+                params.append(self._text(node))
+        return params
+
     def _extract_parameters(self, params_node) -> list[str]:
         """
         提取函数参数
@@ -296,20 +739,325 @@ class CommentExtractor(Extractor):
         params = []
         for child in params_node.children:
             if child.type == "identifier":
-                params.append(child.text.decode("utf-8"))
+                params.append(self._text(child))
             elif child.type == "typed_parameter":
                 for subchild in child.children:
                     if subchild.type == "identifier":
-                        params.append(subchild.text.decode("utf-8"))
+                        params.append(self._text(subchild))
                         break
             elif child.type == "default_parameter":
                 for subchild in child.children:
                     if subchild.type == "identifier":
-                        params.append(subchild.text.decode("utf-8"))
+                        params.append(self._text(subchild))
                         break
         return params
 
 
+class KeywordExtractor(CommentExtractor):
+    """
+    多关键词提取器：一次扫描源码字节匹配所有关键词，再映射到注释与作用域
+
+    所有关键词编译为一个正则，在原始字节上单次 finditer 得到按偏移排序的命中；
+    没有命中的文件不做语法分析。有命中时复用 CommentExtractor 的单次遍历，
+    按先序经过的（叶子）节点与命中偏移做归并：位于注释/docstring 内的命中归入
+    该注释，其余归入所在代码行，两者都带有所在作用域。
+
+    产出的记录与注释记录结构相同（text / start_line / end_line / scope_id），
+    另含命中的 keywords，可直接接入 CoRex 的分析流水线。
+    """
+
+    def __init__(
+        self,
+        language: str,
+        keywords: Sequence[str] = DEFAULT_KEYWORDS,
+        workers: int = 1,
+        path_filter: Optional[PathFilter] = None,
+        index: Optional[ExtractionIndex] = None,
+    ):
+        """
+        Args:
+            language: 源码语言
+            keywords: 关键词列表，按字面匹配、区分大小写
+            workers: 解析进程数，含义同 CommentExtractor
+            path_filter: 目录扫描的过滤条件，含义同 CommentExtractor
+            index: 提取结果索引，含义同 CommentExtractor
+        """
+        super().__init__(
+            language=language, workers=workers, path_filter=path_filter, index=index
+        )
+        self.keywords = list(keywords)
+        self.pattern = compile_keywords(self.keywords)
+        self._hits: list[re.Match] = []
+        self._next_hit = 0
+
+    def _worker_kwargs(self) -> dict[str, Any]:
+        return {"keywords": self.keywords}
+
+    def _collect_comments(self) -> list[dict[str, Any]]:
+        self._hits = list(self.pattern.finditer(self.source_code))
+        self._next_hit = 0
+        if not self._hits:
+            return []
+        records: list[dict[str, Any]] = []
+        root_node = self._parse_tree()
+        self._extract_comments(root_node, records)
+        # 最后一个节点之后的命中（理论上只有尾部空白，防御性处理）
+        self._take_code(len(self.source_code), records)
+        mark_header(root_node, records)
+        return records
+
+    def _visit(self, node, comments: list) -> None:
+        if self._next_hit >= len(self._hits):
+            return
+        if node.type == "comment":
+            self._take_comment(
+                node, lambda: self._extract_comment_info(node), comments
+            )
+        elif (
+            node.type == "expression_statement"
+            and node.children
+            and node.children[0].type == "string"
+            and self._is_docstring(node)
+        ):
+            string_node = node.children[0]
+            self._take_comment(
+                string_node,
+                lambda: self._extract_docstring_info(string_node, node),
+                comments,
+            )
+        elif node.child_count == 0:
+            self._take_code(node.end_byte, comments)
+
+    def _pop_hits(self, end: int) -> list[re.Match]:
+        """取出偏移在 end 之前、尚未归属的命中"""
+        start = self._next_hit
+        while self._next_hit < len(self._hits) and (
+            self._hits[self._next_hit].start() < end
+        ):
+            self._next_hit += 1
+        return self._hits[start : self._next_hit]
+
+    def _take_comment(
+        self, node, build: Callable[[], dict[str, Any]], records: list
+    ) -> None:
+        """归属注释内的命中；build 生成注释记录，只在有命中时调用以免登记无关作用域"""
+        # 注释之前的命中位于代码中
+        self._take_code(node.start_byte, records)
+        hits = self._pop_hits(node.end_byte)
+        if not hits:
+            return
+        info = build()
+        info["keywords"] = sorted({self._keyword(hit) for hit in hits})
+        records.append(info)
+
+    def _take_code(self, end: int, records: list) -> None:
+        hits = self._pop_hits(end)
+        if not hits:
+            return
+        scope_id = self._current_scope()
+        for line, group in itertools.groupby(hits, key=self._line_of):
+            keywords = {self._keyword(hit) for hit in group}
+            last = records[-1] if records else None
+            if last and last["type"] == "code" and last["start_line"] == line + 1:
+                # 同一行的命中来自多个节点时合并为一条记录
+                last["keywords"] = sorted(keywords.union(last["keywords"]))
+                continue
+            text = self.source.lines(line + 1, line + 1)
+            records.append(
+                {
+                    "type": "code",
+                    "text": text.strip(),
+                    "start_line": line + 1,
+                    "end_line": line + 1,
+                    "scope_id": scope_id,
+                    "keywords": sorted(keywords),
+                }
+            )
+
+    def _line_of(self, hit: re.Match) -> int:
+        """命中所在行（从 0 开始），在行首偏移表上二分查找"""
+        return self.source.line_of(hit.start())
+
+    @staticmethod
+    def _keyword(hit: re.Match) -> str:
+        return hit.group(0).decode("utf-8", errors="replace")
+
+
+def mark_header(root_node, comments: list[dict[str, Any]]) -> None:
+    """
+    为文件开头注释块中的注释（位于第一个非注释节点之前）加上 header 标记，
+    许可证声明等文件头只在这里出现，预过滤据此区分文件头与正文中的注释
+    """
+    code_line = next(
+        (
+            child.start_point[0] + 1
+            for child in root_node.children
+            if child.type != "comment"
+        ),
+        None,
+    )
+    for comment in comments:
+        if code_line is None or comment["end_line"] < code_line:
+            comment["header"] = True
+
+
+def compile_keywords(keywords: Sequence[str]) -> re.Pattern[bytes]:
+    """
+    将关键词编译为单个字节正则；以单词字符开头/结尾的关键词加上单词边界，
+    避免 TODO 命中 TODOS、unsafe 命中 unsafe_ptr 之外的更长标识符
+
+    Args:
+        keywords: 关键词列表
+
+    Returns:
+        匹配任一关键词的正则，较长的关键词优先
+    """
+    if not keywords:
+        raise ValueError("At least one keyword is required")
+    alternatives = []
+    for keyword in sorted(set(keywords), key=len, reverse=True):
+        pattern = re.escape(keyword.encode("utf-8"))
+        if re.match(rb"\w", keyword.encode("utf-8")[:1]):
+            pattern = rb"\b" + pattern
+        if re.match(rb"\w", keyword.encode("utf-8")[-1:]):
+            pattern = pattern + rb"\b"
+        alternatives.append(pattern)
+    return re.compile(b"|".join(alternatives))
+
+
+def _common_prefix(a: bytes, b: bytes) -> int:
+    """a 与 b 公共前缀的长度，二分比较切片，避免逐字节的 Python 循环"""
+    lo, hi = 0, min(len(a), len(b))
+    while lo < hi:
+        mid = (lo + hi + 1) // 2
+        if a[:mid] == b[:mid]:
+            lo = mid
+        else:
+            hi = mid - 1
+    return lo
+
+
+def _common_suffix(a: bytes, b: bytes, limit: int) -> int:
+    """a 与 b 公共后缀的长度，且不超过 limit"""
+    lo, hi = 0, limit
+    while lo < hi:
+        mid = (lo + hi + 1) // 2
+        if a[len(a) - mid :] == b[len(b) - mid :]:
+            lo = mid
+        else:
+            hi = mid - 1
+    return lo
+
+
+def _point(source: bytes, offset: int) -> tuple[int, int]:
+    """字节偏移对应的 (行, 列)，列以字节计，与 tree-sitter 的 Point 一致"""
+    row = source.count(b"\n", 0, offset)
+    return row, offset - (source.rfind(b"\n", 0, offset) + 1)
+
+
+def input_edit(old: bytes, new: bytes) -> dict[str, Any]:
+    """
+    将 old 到 new 的变化描述为一次编辑，作为 Tree.edit 的参数
+
+    编辑区间为去掉公共前缀与公共后缀后剩下的部分；一次保存中的多处修改
+    会合并为一个覆盖它们的区间，增量解析仍能复用区间外的子树。
+    """
+    start = _common_prefix(old, new)
+    suffix = _common_suffix(old, new, min(len(old), len(new)) - start)
+    old_end, new_end = len(old) - suffix, len(new) - suffix
+    return {
+        "start_byte": start,
+        "old_end_byte": old_end,
+        "new_end_byte": new_end,
+        "start_point": _point(old, start),
+        "old_end_point": _point(old, old_end),
+        "new_end_point": _point(new, new_end),
+    }
+
+
+def language_of(file: Path) -> str:
+    """
+    按后缀判断文件的语言
+
+    Raises:
+        ValueError: 后缀不在 LANGUAGE_SUFFIX_MAP 中
+    """
+    suffix = file.suffix
+    language = SUFFIX_LANGUAGE_MAP.get(suffix, SUFFIX_LANGUAGE_MAP.get(suffix.lower()))
+    if language is None:
+        raise ValueError(f"Cannot detect language from suffix {suffix!r}")
+    return language
+
+
+def open_result_source(file_result: dict[str, Any]) -> Optional[SourceFile]:
+    """
+    重新打开提取结果对应的源文件，按作用域的行区间截取代码
+
+    Returns:
+        文件不可读或内容与提取时不同（content_hash 不一致）时返回 None，
+        此时行号已经对不上，调用方不使用代码上下文
+    """
+    filename = file_result.get("file")
+    if not filename:
+        return None
+    try:
+        source = SourceFile(Path(filename))
+    except OSError as e:
+        logger.warning(f"Cannot reopen {filename} for context: {e!s}")
+        return None
+    expected = file_result.get("content_hash")
+    if expected is not None and source.digest() != expected:
+        logger.warning(f"{filename} changed since extraction, skipping its context")
+        source.close()
+        return None
+    return source
+
+
+def read_scope_code(source: Optional[SourceFile], scope: dict[str, Any]) -> str:
+    """作用域的源码；source 为 None（见 open_result_source）时为空字符串"""
+    if source is None:
+        return ""
+    return source.lines(scope["start_line"], scope["end_line"])
+
+
+def scope_chain(file_result: dict[str, Any], scope_id: Optional[int]) -> list[dict]:
+    """
+    根据作用域 id 还原由外到内的上下文链
+
+    Args:
+        file_result: 单个文件的提取结果
+        scope_id: 注释的 scope_id
+
+    Returns:
+        作用域信息列表，最外层在前，模块级注释返回空列表
+    """
+    scopes = file_result.get("scopes", [])
+    chain = []
+    while scope_id is not None:
+        scope = scopes[scope_id]
+        chain.append(scope)
+        scope_id = scope["parent"]
+    chain.reverse()
+    return chain
+
+
+# 进程池 worker 中的提取器，每个进程在初始化时各自创建一个
+_worker_extractor: CommentExtractor | None = None
+
+
+def _init_worker(
+    extractor_cls: type[CommentExtractor], language: str, kwargs: dict[str, Any]
+) -> None:
+    global _worker_extractor
+    _worker_extractor = extractor_cls(language=language, **kwargs)
+
+
+def _parse_in_worker(file: Path) -> dict[str, Any]:
+    if _worker_extractor is None:
+        raise RuntimeError("Parse worker used before _init_worker ran")
+    return _worker_extractor._parse_single(file)
+
+
 # python -m corex.extractor
 if __name__ == "__main__":
     extractor = CommentExtractor(language="cpp")
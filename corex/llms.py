@@ -1,44 +1,685 @@
+import asyncio
+import hashlib
+import json
+import math
+import random
+import re
+import time
+from collections import deque
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Any, Callable, Optional
+
 import yaml
+from langchain_core.messages import AIMessage, BaseMessage
+from langchain_core.rate_limiters import InMemoryRateLimiter
 from langchain_openai import ChatOpenAI
 from loguru import logger
 from pydantic import SecretStr
 
-from .config import LLM_KEYS_PATH, MODEL_CONFIG_PATH
+from .config import DEFAULT_MAX_CONCURRENCY, LLM_KEYS_PATH, MODEL_CONFIG_PATH
+from .metrics import METRICS
+
+# 可重试的 HTTP 状态码；没有状态码的异常（连接错误、超时）同样重试
+RETRYABLE_STATUS = {408, 409, 429, 500, 502, 503, 504}
+# 说明端点本身不可用（key 失效、无权限、模型不存在）的状态码，遇到后停用该端点
+DISABLING_STATUS = {401, 403, 404}
+# openai：OpenAI 兼容的在线服务，需要 key；local：本地部署的 OpenAI 兼容服务
+# （vLLM、llama.cpp server 等），key 可省略；mock：进程内的模拟模型，不发网络请求
+PROVIDERS = ("openai", "local", "mock")
+
+
+@dataclass
+class RetryPolicy:
+    """指数退避重试策略，对应 model_config.yaml 中的 retry 配置"""
+
+    max_retries: int = 5
+    base_delay: float = 1.0
+    max_delay: float = 60.0
+
+    def delay(self, attempt: int, error: Exception) -> Optional[float]:
+        """
+        计算第 attempt 次失败后的等待时间
+
+        Args:
+            attempt: 已失败的次数（从 0 开始）
+            error: 本次失败的异常
+
+        Returns:
+            等待秒数；不可重试或重试次数用尽时返回 None
+        """
+        if attempt >= self.max_retries:
+            return None
+        status = getattr(error, "status_code", None)
+        if status is not None and status not in RETRYABLE_STATUS:
+            return None
+        retry_after = _retry_after(error)
+        if retry_after is not None:
+            return min(retry_after, self.max_delay)
+        # full jitter，避免大量并发请求同时重试
+        backoff = min(self.max_delay, self.base_delay * 2**attempt)
+        return random.uniform(backoff / 2, backoff)
+
+
+def _retry_after(error: Exception) -> Optional[float]:
+    """读取响应头中的 Retry-After（秒）或 retry-after-ms"""
+    response = getattr(error, "response", None)
+    headers = getattr(response, "headers", None)
+    if not headers:
+        return None
+    try:
+        if "retry-after-ms" in headers:
+            return float(headers["retry-after-ms"]) / 1000
+        if "retry-after" in headers:
+            return float(headers["retry-after"])
+    except (TypeError, ValueError):
+        # HTTP-date 格式的 Retry-After 退回指数退避
+        return None
+    return None
+
+
+@dataclass
+class HedgePolicy:
+    """
+    对冲请求策略：请求耗时超过阈值时再发一份相同请求，取先返回的结果
+
+    after 为固定阈值（秒）；为 None 时使用最近延迟的 quantile 分位数，
+    样本数不足 min_samples 时不对冲。同时在途的对冲请求不超过 max_inflight
+    （默认为 max_concurrency 的 1/10，至少 1），达到上限时只等待原请求。
+    """
+
+    enabled: bool = False
+    after: Optional[float] = None
+    quantile: float = 0.95
+    min_samples: int = 20
+    max_inflight: Optional[int] = None
+
+
+class LatencyTracker:
+    """记录最近的请求延迟，用于计算对冲阈值"""
+
+    def __init__(self, window: int = 256):
+        self.samples: deque[float] = deque(maxlen=window)
+
+    def record(self, seconds: float) -> None:
+        self.samples.append(seconds)
+
+    def quantile(self, q: float) -> Optional[float]:
+        if not self.samples:
+            return None
+        ordered = sorted(self.samples)
+        return ordered[min(len(ordered) - 1, int(q * len(ordered)))]
+
+
+@dataclass
+class TokenUsage:
+    """
+    累计 token 用量，其中 cached_tokens 为命中服务端前缀缓存的输入 token
+
+    兼容 langchain 的 usage_metadata（OpenAI 的 cache_read）与 DeepSeek
+    返回的 prompt_cache_hit_tokens。
+    """
+
+    requests: int = 0
+    input_tokens: int = 0
+    cached_tokens: int = 0
+    output_tokens: int = 0
+
+    def add(self, response: Any) -> None:
+        usage = getattr(response, "usage_metadata", None) or {}
+        metadata = getattr(response, "response_metadata", None) or {}
+        token_usage = metadata.get("token_usage") or {}
+
+        cached = (usage.get("input_token_details") or {}).get("cache_read")
+        if cached is None:
+            cached = token_usage.get("prompt_cache_hit_tokens")
+        if cached is None:
+            details = token_usage.get("prompt_tokens_details") or {}
+            cached = details.get("cached_tokens")
+
+        input_tokens = usage.get("input_tokens") or token_usage.get("prompt_tokens", 0)
+        output_tokens = usage.get("output_tokens") or token_usage.get(
+            "completion_tokens", 0
+        )
+        self.requests += 1
+        self.input_tokens += input_tokens
+        self.output_tokens += output_tokens
+        self.cached_tokens += cached or 0
+        METRICS.counter("llm_input_tokens", "Prompt tokens sent").inc(input_tokens)
+        METRICS.counter("llm_output_tokens", "Completion tokens received").inc(
+            output_tokens
+        )
+        METRICS.counter(
+            "llm_cached_tokens", "Prompt tokens served from the provider cache"
+        ).inc(cached or 0)
+
+    @property
+    def cached_ratio(self) -> float:
+        return self.cached_tokens / self.input_tokens if self.input_tokens else 0.0
+
+
+class Endpoint:
+    """
+    一个 LLM 服务端点（base_url + api key + 模型）
+
+    记录在途请求数、延迟的指数滑动平均与连续失败次数，供 Router 负载均衡；
+    失败后进入冷却期，鉴权类错误（401/403/404）直接停用。
+    """
+
+    def __init__(self, name: str, client: ChatOpenAI, weight: float = 1.0):
+        self.name = name
+        self.client = client
+        self.weight = weight
+        self.inflight = 0
+        self.ewma_latency: Optional[float] = None
+        self.failures = 0
+        self.cooldown_until = 0.0
+        self.disabled = False
+
+    def score(self) -> float:
+        """权重越高、越空闲、越快的端点得分越高"""
+        latency = self.ewma_latency or 1.0
+        return self.weight / ((self.inflight + 1) * latency)
+
+    def healthy(self, now: float) -> bool:
+        return not self.disabled and now >= self.cooldown_until
+
+    def succeed(self, seconds: float) -> None:
+        self.failures = 0
+        if self.ewma_latency is None:
+            self.ewma_latency = seconds
+        else:
+            self.ewma_latency = 0.8 * self.ewma_latency + 0.2 * seconds
+
+    def fail(self, error: Exception, retry: RetryPolicy) -> None:
+        self.failures += 1
+        status = getattr(error, "status_code", None)
+        if status in DISABLING_STATUS:
+            if not self.disabled:
+                logger.error(f"Disabling LLM endpoint {self.name}: {error!s}")
+            self.disabled = True
+            return
+        cooldown = _retry_after(error)
+        if cooldown is None:
+            cooldown = retry.base_delay * 2 ** (self.failures - 1)
+        self.cooldown_until = time.monotonic() + min(cooldown, retry.max_delay)
+
+
+class Router:
+    """
+    多端点路由：按 权重 / (在途数 × 延迟) 加权随机选择健康端点，
+    全部处于冷却期时选择最早恢复的端点
+    """
+
+    def __init__(self, endpoints: list[Endpoint]):
+        if not endpoints:
+            raise ValueError("API key is required. ")
+        self.endpoints = endpoints
+
+    def healthy(self) -> list[Endpoint]:
+        now = time.monotonic()
+        return [e for e in self.endpoints if e.healthy(now)]
+
+    def choose(self, exclude: Optional[Endpoint] = None) -> Endpoint:
+        candidates = [e for e in self.healthy() if e is not exclude] or self.healthy()
+        if not candidates:
+            alive = [e for e in self.endpoints if not e.disabled]
+            if not alive:
+                raise RuntimeError("All LLM endpoints are disabled")
+            return min(alive, key=lambda e: e.cooldown_until)
+        return random.choices(candidates, weights=[e.score() for e in candidates])[0]
+
+
+@dataclass
+class MockConfig:
+    """模拟模型的行为，对应 model_config.yaml 中的 mock 配置"""
+
+    # 延迟分布：fixed / normal / lognormal / exponential，latency 为均值（秒）
+    distribution: str = "normal"
+    latency: float = 0.2
+    jitter: float = 0.05
+    # 判为有问题（Typo）的注释比例，按注释内容哈希决定，同一注释结论始终相同
+    issue_rate: float = 0.1
+    # 以 429 失败的请求比例，用于压测重试与端点切换
+    error_rate: float = 0.0
+    seed: int = 0
+
+
+# 批量请求中每条注释的标题（见 AnalyzerWithoutContext.build_batch_messages），
+# 需独占一行且紧跟 ### Comment，注释正文中出现的 "## Case" 不会被当作标题
+_CASE_HEADER = re.compile(r"^## Case(\d+)\n### Comment\n", re.MULTILINE)
+
+
+def mock_content(text: str, verdict: Callable[[str], dict[str, Any]]) -> str:
+    """
+    模拟响应的文本：批量请求返回 {"cases": [...]}，单条请求返回一个结论
+
+    进程内的 mock provider 与基准测试的模拟 HTTP 服务共用这一解析。
+
+    Args:
+        text: 最后一条（user）消息
+        verdict: 由注释文本生成结论的函数
+    """
+    parts = _CASE_HEADER.split(text)
+    if len(parts) == 1:
+        # 单条请求：小节标题之后即注释
+        return json.dumps(verdict(text.split("\n\n", 1)[-1]), ensure_ascii=False)
+    cases = [
+        {"case": int(index), **verdict(body)}
+        for index, body in zip(parts[1::2], parts[2::2])
+    ]
+    return json.dumps({"cases": cases}, ensure_ascii=False)
+
+
+class MockLLMError(Exception):
+    """模拟的限流错误，与 openai.RateLimitError 一样带 status_code"""
+
+    status_code = 429
+    response = None
+
+
+class MockChatModel:
+    """
+    进程内的模拟聊天模型，实现 CoRex 用到的 ChatOpenAI 接口（invoke / ainvoke）
+
+    按配置的分布休眠后返回与提示词输出格式一致的 JSON 结论，
+    批量请求（## Case<i>）返回 {"cases": [...]}；响应带有估算的 token 用量，
+    system 消息计为命中前缀缓存。
+    """
+
+    def __init__(
+        self,
+        model: str,
+        config: MockConfig,
+        rate_limiter: Optional[InMemoryRateLimiter] = None,
+    ):
+        if config.distribution not in ("fixed", "normal", "lognormal", "exponential"):
+            raise ValueError(f"Unsupported mock distribution: {config.distribution}")
+        self.model = model
+        self.config = config
+        self.rng = random.Random(config.seed)
+        self.rate_limiter = rate_limiter
+
+    def sample_latency(self) -> float:
+        config = self.config
+        if config.distribution == "fixed" or config.latency <= 0:
+            return max(0.0, config.latency)
+        if config.distribution == "exponential":
+            return self.rng.expovariate(1 / config.latency)
+        if config.distribution == "lognormal":
+            # 按均值与标准差换算对数正态分布的参数
+            sigma2 = math.log(1 + (config.jitter / config.latency) ** 2)
+            mu = math.log(config.latency) - sigma2 / 2
+            return self.rng.lognormvariate(mu, math.sqrt(sigma2))
+        return max(0.0, self.rng.gauss(config.latency, config.jitter))
+
+    def invoke(self, prompt: str | list[BaseMessage], **kwargs) -> AIMessage:
+        if self.rate_limiter is not None:
+            self.rate_limiter.acquire()
+        time.sleep(self.sample_latency())
+        return self._respond(prompt)
+
+    async def ainvoke(self, prompt: str | list[BaseMessage], **kwargs) -> AIMessage:
+        if self.rate_limiter is not None:
+            await self.rate_limiter.aacquire()
+        await asyncio.sleep(self.sample_latency())
+        return self._respond(prompt)
+
+    def _respond(self, prompt: str | list[BaseMessage]) -> AIMessage:
+        if self.rng.random() < self.config.error_rate:
+            raise MockLLMError("Mock rate limit exceeded")
+        messages = [prompt] if isinstance(prompt, str) else [m.content for m in prompt]
+        content = mock_content(str(messages[-1]), self._verdict)
+
+        # 粗略按 4 字符 1 token 估算用量
+        input_tokens = sum(len(str(m)) for m in messages) // 4
+        cached = len(str(messages[0])) // 4 if len(messages) > 1 else 0
+        return AIMessage(
+            content=content,
+            usage_metadata={
+                "input_tokens": input_tokens,
+                "output_tokens": len(content) // 4,
+                "total_tokens": input_tokens + len(content) // 4,
+                "input_token_details": {"cache_read": cached},
+            },
+            response_metadata={"model_name": self.model},
+        )
+
+    def _verdict(self, comment: str) -> dict[str, Any]:
+        comment = comment.strip()
+        digest = hashlib.sha1(f"{self.config.seed}:{comment}".encode()).digest()
+        if int.from_bytes(digest[:4], "big") / 2**32 >= self.config.issue_rate:
+            return {"type": "Normal"}
+        return {"type": "Typo", "detail": "Mock verdict", "replacement": comment}
 
 
 class LLM:
     def __init__(
         self,
         model_name: str = "deepseek-chat",
+        keys_path: Optional[Path] = None,
+        model_config_path: Optional[Path] = None,
     ):
-        with open(LLM_KEYS_PATH, "r", encoding="utf-8") as f:
-            llm_keys = yaml.safe_load(f)
-        api_key = llm_keys.get(model_name, {})
-        if not api_key:
-            raise ValueError("API key is required. ")
-        with open(MODEL_CONFIG_PATH, "r", encoding="utf-8") as f:
+        """
+        Args:
+            model_name: model_config.yaml 中的模型名称
+            keys_path: llm_keys.yaml 的路径，默认使用 llm_config 下的文件
+            model_config_path: model_config.yaml 的路径，默认使用 llm_config 下的文件
+        """
+        keys_path = Path(keys_path or LLM_KEYS_PATH)
+        llm_keys = {}
+        # 只使用本地服务或模拟模型时可以没有 llm_keys.yaml
+        if keys_path.exists():
+            with open(keys_path, "r", encoding="utf-8") as f:
+                llm_keys = yaml.safe_load(f) or {}
+        with open(model_config_path or MODEL_CONFIG_PATH, "r", encoding="utf-8") as f:
             model_configs = yaml.safe_load(f)
 
+        # 以下是 CoRex 自身的调度参数，不透传给 ChatOpenAI
+        model_config = dict(model_configs.get(model_name, {}))
+        rate_limit = model_config.pop("rate_limit", None)
+        max_concurrency = model_config.pop("max_concurrency", None)
+        self.timeout: Optional[float] = model_config.pop("timeout", None)
+        self.retry = RetryPolicy(**model_config.pop("retry", {}))
+        self.hedge = HedgePolicy(**model_config.pop("hedge", {}))
+        self.latency = LatencyTracker()
+        self.usage = TokenUsage()
+        self.provider = model_config.pop("provider", "openai")
+        # 是否请求 JSON 输出（response_format=json_object），不支持的服务可关闭
+        self.json_mode = bool(model_config.pop("json_mode", True))
+        self.mock = MockConfig(**model_config.pop("mock", {}))
+        endpoint_configs = model_config.pop("endpoints", None)
+        base_url = model_config.pop("base_url", None)
+
         self.model_name = model_name
+        # 影响生成结果的配置，参与分析缓存的 key（与端点无关）
+        self.model_config = model_config
+        if endpoint_configs is None:
+            endpoint_configs = [{"base_url": base_url}]
+        # 端点可以改用其它模型提供服务，实际使用的模型参与分析缓存的 key；
+        # 都是 model_name 时保持原样，已有缓存仍然有效
+        served = sorted({c.get("model", model_name) for c in endpoint_configs})
+        self.model_id = (
+            model_name
+            if served == [model_name]
+            else f"{model_name}[{','.join(served)}]"
+        )
         try:
-            self.llm = ChatOpenAI(
-                model=model_name,
-                api_key=SecretStr(api_key),
-                **model_configs.get(model_name, {}),
-            )
-            logger.success(f"Initialized LLM with model: {model_name}")
+            endpoints = [
+                endpoint
+                for endpoint_config in endpoint_configs
+                for endpoint in self._build_endpoints(
+                    endpoint_config, llm_keys, base_url, rate_limit
+                )
+            ]
         except Exception as e:
             raise Exception(f"Failed to initialize LLM: {e!s}") from e
+        self.router = Router(endpoints)
+        self.max_concurrency = int(
+            max_concurrency or DEFAULT_MAX_CONCURRENCY * len(endpoints)
+        )
+        # 对冲请求不占用调度器的并发名额，单独限制其在途数
+        self.max_hedges = self.hedge.max_inflight or max(1, self.max_concurrency // 10)
+        self.hedges = 0
+        logger.success(
+            f"Initialized LLM with model: {model_name} ({len(endpoints)} endpoints)"
+        )
+
+    def _build_endpoints(
+        self,
+        endpoint_config: dict[str, Any],
+        llm_keys: dict[str, Any],
+        base_url: Optional[str],
+        rate_limit: Optional[dict[str, Any]],
+    ) -> list[Endpoint]:
+        """
+        根据一条端点配置创建端点；llm_keys.yaml 中的 key 为列表时，每个 key 一个端点
 
-    def generate(self, prompt: str) -> str:
+        Args:
+            endpoint_config: provider / base_url / key（llm_keys.yaml 中的名称）/
+                model / weight / rate_limit，均可省略
+            llm_keys: llm_keys.yaml 的内容
+            base_url: 模型级 base_url，端点未指定时使用
+            rate_limit: 模型级限速，端点未指定时使用（每个端点独立计数）
+        """
+        endpoint_config = dict(endpoint_config)
+        provider = endpoint_config.pop("provider", self.provider)
+        if provider not in PROVIDERS:
+            raise ValueError(f"Unsupported LLM provider: {provider}")
+        key_name = endpoint_config.pop("key", self.model_name)
+        api_keys = llm_keys.get(key_name)
+        if not isinstance(api_keys, list):
+            api_keys = [api_keys]
+        url = endpoint_config.pop("base_url", None) or base_url
+        model = endpoint_config.pop("model", self.model_name)
+        weight = float(endpoint_config.pop("weight", 1.0))
+        limit = endpoint_config.pop("rate_limit", rate_limit)
+
+        if provider == "mock":
+            client = MockChatModel(
+                model,
+                self.mock,
+                rate_limiter=InMemoryRateLimiter(**limit) if limit else None,
+            )
+            return [Endpoint(f"mock:{model}", client, weight)]
+        if provider == "local":
+            if not url:
+                raise ValueError("The local provider requires a base_url")
+            # 本地服务通常不校验 key，但 OpenAI 客户端要求非空
+            api_keys = [key for key in api_keys if key] or ["EMPTY"]
+
+        endpoints = []
+        for i, api_key in enumerate(api_keys):
+            if not api_key:
+                continue
+            client = ChatOpenAI(
+                model=model,
+                api_key=SecretStr(api_key),
+                base_url=url,
+                rate_limiter=InMemoryRateLimiter(**limit) if limit else None,
+                timeout=self.timeout,
+                # 重试由 RetryPolicy 统一负责
+                max_retries=0,
+                **{**self.model_config, **endpoint_config},
+            )
+            name = f"{model}@{url or 'default'}#{key_name}[{i}]"
+            endpoints.append(Endpoint(name, client, weight))
+        return endpoints
+
+    def output_options(self, max_tokens: Optional[int] = None) -> dict[str, Any]:
+        """
+        结构化输出的请求参数，随单次请求传给 invoke / ainvoke
+
+        Args:
+            max_tokens: 本次请求的输出 token 上限，None 表示沿用模型配置
+        """
+        options: dict[str, Any] = {}
+        if max_tokens is not None:
+            options["max_tokens"] = max_tokens
+        if self.json_mode:
+            options["response_format"] = {"type": "json_object"}
+        return options
+
+    def generate(self, prompt: str | list[BaseMessage], **kwargs) -> str:
+        """
+        同步生成
+
+        Args:
+            prompt: 提示词或消息列表
+            **kwargs: 单次请求的参数（如 output_options() 的结果），透传给 invoke
+        """
+        attempt = 0
+        while True:
+            endpoint = self.router.choose()
+            try:
+                start = time.perf_counter()
+                endpoint.inflight += 1
+                try:
+                    response = endpoint.client.invoke(prompt, **kwargs)
+                finally:
+                    endpoint.inflight -= 1
+                self._record(endpoint, time.perf_counter() - start, response)
+                return self._content(response)
+            except Exception as e:
+                endpoint.fail(e, self.retry)
+                METRICS.counter("llm_errors", "Failed LLM requests").inc()
+                delay = self._next_delay(attempt, e)
+                if delay is None:
+                    raise Exception(f"Failed to generate content: {e!s}") from e
+                self._log_retry(endpoint, e, delay)
+                time.sleep(delay)
+                attempt += 1
+
+    async def agenerate(self, prompt: str | list[BaseMessage], **kwargs) -> str:
+        """异步生成，参数同 generate"""
+        attempt = 0
+        while True:
+            try:
+                return self._content(await self._ainvoke_hedged(prompt, **kwargs))
+            except Exception as e:
+                delay = self._next_delay(attempt, e)
+                if delay is None:
+                    raise Exception(f"Failed to generate content: {e!s}") from e
+                self._log_retry(None, e, delay)
+                await asyncio.sleep(delay)
+                attempt += 1
+
+    def _next_delay(self, attempt: int, error: Exception) -> Optional[float]:
+        """
+        还有健康端点时立即切换重试；否则按退避策略等待。
+        请求本身有误（如 400）时不重试；端点被停用时只切换到其他端点。
+        """
+        if attempt >= self.retry.max_retries:
+            return None
+        delay = self.retry.delay(attempt, error)
+        failover = getattr(error, "status_code", None) in DISABLING_STATUS
+        if delay is None and not failover:
+            return None
+        if self.router.healthy():
+            return 0.0
+        return delay
+
+    @staticmethod
+    def _log_retry(endpoint: Optional[Endpoint], error: Exception, delay: float):
+        METRICS.counter("llm_retries", "Retried LLM requests").inc()
+        where = f" on {endpoint.name}" if endpoint is not None else ""
+        logger.warning(
+            f"LLM request failed{where} ({type(error).__name__}: {error!s}), "
+            f"retrying in {delay:.1f}s"
+        )
+
+    def _record(self, endpoint: Endpoint, seconds: float, response: Any) -> None:
+        endpoint.succeed(seconds)
+        self.latency.record(seconds)
+        self.usage.add(response)
+        METRICS.counter("llm_requests", "Successful LLM requests").inc()
+        METRICS.histogram(
+            "llm_latency_seconds", "Latency of successful LLM requests"
+        ).observe(seconds)
+
+    def log_usage(self) -> None:
+        usage = self.usage
+        if not usage.requests:
+            return
+        logger.info(
+            f"LLM usage ({self.model_name}): {usage.requests} requests, "
+            f"{usage.input_tokens} input tokens "
+            f"({usage.cached_tokens} cached, {usage.cached_ratio:.1%}), "
+            f"{usage.output_tokens} output tokens"
+        )
+
+    async def _ainvoke(
+        self, prompt: str | list[BaseMessage], endpoint: Endpoint, **kwargs
+    ) -> Any:
+        """在指定端点上发起单次异步请求，超过 timeout 视为失败"""
+        start = time.perf_counter()
+        endpoint.inflight += 1
         try:
-            response = self.llm.invoke(prompt)
-            content = response.content
-            if isinstance(content, str):
-                return content
-            return str(content)
+            response = await asyncio.wait_for(
+                endpoint.client.ainvoke(prompt, **kwargs), self.timeout
+            )
         except Exception as e:
-            raise Exception(f"Failed to generate content: {e!s}") from e
+            endpoint.fail(e, self.retry)
+            METRICS.counter("llm_errors", "Failed LLM requests").inc()
+            raise
+        finally:
+            endpoint.inflight -= 1
+        self._record(endpoint, time.perf_counter() - start, response)
+        return response
+
+    def _hedge_threshold(self) -> Optional[float]:
+        if not self.hedge.enabled:
+            return None
+        if self.hedge.after is not None:
+            return self.hedge.after
+        if len(self.latency.samples) < self.hedge.min_samples:
+            return None
+        return self.latency.quantile(self.hedge.quantile)
+
+    async def _ainvoke_hedged(self, prompt: str | list[BaseMessage], **kwargs) -> Any:
+        """
+        发起请求，超过对冲阈值仍未返回时向另一个端点追加一份相同请求，
+        返回先成功的结果并取消另一份；两份都失败时抛出最后的异常
+
+        调用方被取消时，原请求与对冲请求都会被取消，不会遗留在途请求。
+        """
+        threshold = self._hedge_threshold()
+        endpoint = self.router.choose()
+        primary = asyncio.ensure_future(self._ainvoke(prompt, endpoint, **kwargs))
+        pending = {primary}
+        error: Optional[BaseException] = None
+        try:
+            if threshold is not None:
+                done, _ = await asyncio.wait(pending, timeout=threshold)
+                if not done:
+                    backup = self._hedge(prompt, endpoint, threshold, **kwargs)
+                    if backup is not None:
+                        pending.add(backup)
+            while pending:
+                done, pending = await asyncio.wait(
+                    pending, return_when=asyncio.FIRST_COMPLETED
+                )
+                for task in done:
+                    if task.exception() is None:
+                        return task.result()
+                    error = task.exception()
+        finally:
+            for task in pending:
+                task.cancel()
+        if error is None:
+            raise RuntimeError("Hedged request finished without a result or an error")
+        raise error
+
+    def _hedge(
+        self,
+        prompt: str | list[BaseMessage],
+        endpoint: Endpoint,
+        threshold: float,
+        **kwargs,
+    ) -> Optional[asyncio.Future]:
+        """向 endpoint 以外的端点追加一份请求，对冲请求已达上限时返回 None"""
+        if self.hedges >= self.max_hedges:
+            METRICS.counter(
+                "llm_hedges_skipped", "Hedges skipped at the in-flight cap"
+            ).inc()
+            return None
+        logger.debug(f"Hedging request after {threshold:.2f}s")
+        METRICS.counter("llm_hedged", "Requests duplicated by hedging").inc()
+        self.hedges += 1
+        backup = self.router.choose(exclude=endpoint)
+        future = asyncio.ensure_future(self._ainvoke(prompt, backup, **kwargs))
+        future.add_done_callback(self._hedge_done)
+        return future
+
+    def _hedge_done(self, future: asyncio.Future) -> None:
+        self.hedges -= 1
+
+    @staticmethod
+    def _content(response) -> str:
+        content = response.content
+        if isinstance(content, str):
+            return content
+        return str(content)
 
     def __repr__(self) -> str:
         """Return string representation of the agent."""
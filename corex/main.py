@@ -1,11 +1,41 @@
+import asyncio
 from pathlib import Path
+from typing import Any, Iterator, Optional
 
 import typer
 from loguru import logger
 
-from .analyzer import Analyzer, AnalyzerWithContext, AnalyzerWithoutContext
+from .analyzer import (
+    Analyzer,
+    AnalyzerWithContext,
+    AnalyzerWithoutContext,
+    CascadeAnalyzer,
+)
+from .cache import AnalysisCache, ExtractionIndex
+from .checkpoint import CheckpointJournal
+from .config import (
+    ANALYSIS_CACHE_PATH,
+    DEFAULT_CONTEXT_TOKENS,
+    DEFAULT_EXCLUDE_DIRS,
+    DEFAULT_ROOT_EXCLUDE_DIRS,
+    DEFAULT_KEYWORDS,
+    DEFAULT_MAX_FILE_SIZE,
+    DEFAULT_PIPELINE_DEPTH,
+    DEFAULT_WATCH_INTERVAL,
+    EXTRACTION_INDEX_PATH,
+    IGNORE_FILES,
+)
+from .dispatcher import Dispatcher
 from .extractor import CommentExtractor, Extractor, KeywordExtractor
 from .llms import LLM
+from .metrics import METRICS
+from .prefilter import ClassifierRule, PreFilter
+from .report import REPORT_FORMATS, ReportSink
+from .scheduler import Budget, RiskScorer, prioritize
+from .utils.git import changed_hunks, filter_changed_comments
+from .utils.walk import PathFilter
+from .verdict import format_verdict, is_finding, parse_verdict
+from .watch import FileWatcher
 
 
 class CoRex:
@@ -19,11 +49,38 @@ class CoRex:
         extractor: Extractor,
         analyzer: Analyzer,
         save_path: Path = Path("output.log"),
+        max_concurrency: Optional[int] = None,
+        cache: Optional[AnalysisCache] = None,
+        since: Optional[str] = None,
+        pipeline_depth: int = DEFAULT_PIPELINE_DEPTH,
+        prefilter: Optional[PreFilter] = None,
+        dedup: bool = True,
+        report: Optional[ReportSink] = None,
+        journal: Optional[CheckpointJournal] = None,
+        metrics_path: Optional[Path] = None,
+        prometheus_path: Optional[Path] = None,
+        scorer: Optional[RiskScorer] = None,
+        budget: Optional[Budget] = None,
     ):
         self.file_path = file_path
         self.extractor = extractor
         self.analyzer = analyzer
         self.save_path = save_path
+        self.max_concurrency = max_concurrency or analyzer.llms.max_concurrency
+        self.cache = cache
+        self.since = since
+        self.pipeline_depth = pipeline_depth
+        self.prefilter = prefilter
+        self.dedup = dedup
+        self.report = report or ReportSink.from_formats(Path(save_path), ["text"])
+        self.journal = journal
+        self.metrics_path = metrics_path
+        self.prometheus_path = prometheus_path
+        # 配置 scorer 时按风险分数从高到低分析，budget 限制请求数、token 与时间
+        self.scorer = scorer
+        self.budget = budget
+        # watch 模式下各文件已得到结论的注释，见 _watch
+        self._analyzed: Optional[dict[str, set[str]]] = None
 
     def run(self):
         """
@@ -33,40 +90,310 @@ class CoRex:
         3. 生成分析报告
         """
         logger.info(f"Starting CoRex on file: {self.file_path}")
+        METRICS.reset()
+        if self.budget is not None:
+            self.budget.start()
+        try:
+            asyncio.run(self._run())
+        finally:
+            self._close()
 
-        extraction_result = self.extractor.parse_file(self.file_path)
-        for comment_info in extraction_result:
+    def watch(self, interval: float = DEFAULT_WATCH_INTERVAL):
+        """
+        常驻运行：首轮扫描全部文件，之后轮询文件变化，只重新分析新增或
+        文本/上下文发生变化的注释，直到被中断（Ctrl-C）
+
+        LLM 客户端、缓存连接与语法树在各轮之间保留，修改过的文件在上次的
+        语法树上增量解析。配置了预算时，预算在每轮分析前重置。
+        """
+        logger.info(f"Watching {self.file_path} every {interval:g}s")
+        if self.since is not None:
+            logger.warning("--since is ignored in watch mode")
+        METRICS.reset()
+        self.extractor.keep_trees()
+        try:
+            asyncio.run(self._watch(interval))
+        except KeyboardInterrupt:
+            logger.info("Watch stopped")
+        finally:
+            self._close()
+
+    def _close(self) -> None:
+        """释放各组件持有的资源并输出统计与运行指标"""
+        self.extractor.close()
+        self.report.close()
+        if self.journal is not None:
+            self.journal.close()
+        if self.prefilter is not None:
+            self.prefilter.log_stats()
+        if self.cache is not None:
+            self.cache.log_stats()
+            self.cache.close()
+        if self.budget is not None:
+            self.budget.log_stats()
+        self.analyzer.log_usage()
+        METRICS.log_summary()
+        if self.metrics_path is not None:
+            METRICS.write_json(self.metrics_path)
+        if self.prometheus_path is not None:
+            METRICS.write_prometheus(self.prometheus_path)
+
+    async def _watch(self, interval: float) -> None:
+        watcher = FileWatcher(self.extractor, self.file_path)
+        # 文件 -> 已得到结论的各注释的 (文本, 上下文) 哈希，由写入阶段更新
+        analyzed: dict[str, set[str]] = {}
+        self._analyzed = analyzed
+        while True:
+            changed, removed = await asyncio.to_thread(watcher.poll)
+            for file in removed:
+                self.extractor.forget(file)
+                analyzed.pop(str(file), None)
+            if changed:
+                logger.info(f"{len(changed)} files changed, re-extracting")
+                # 预算按轮计算；超出预算的注释在其文件再次变化时才会被分析
+                if self.budget is not None:
+                    self.budget.reset()
+                await self._run(self._extract_changed(changed, analyzed))
+            await asyncio.sleep(interval)
+
+    def _extract_changed(
+        self, files: list[Path], analyzed: dict[str, set[str]]
+    ) -> Iterator[dict[str, Any]]:
+        """提取变化的文件，只保留文本或上下文与上次不同的注释"""
+        for result in self.extractor.iter_parse_files(files):
+            filename = result["file"]
+            previous = analyzed.get(filename, set())
+            current, fresh = set(), []
+            for comment_dic in result.get("comments", []):
+                context = (
+                    ""
+                    if comment_dic.get("type") == "code"
+                    else self.analyzer.build_context(result, comment_dic)
+                )
+                key = AnalysisCache.make_key(comment_dic.get("text", ""), context)
+                if key in previous:
+                    current.add(key)
+                else:
+                    fresh.append(comment_dic)
+            # 只保留仍然存在的注释；新注释得到结论后由写入阶段加入
+            analyzed[filename] = current
+            logger.info(f"{filename}: {len(fresh)} new or changed comments")
+            yield {**result, "comments": fresh, "total_comments": len(fresh)}
+
+    async def _run(self, results: Optional[Iterator[dict[str, Any]]] = None):
+        """
+        流水线式运行：提取、分析、写报告三个阶段重叠执行。
+
+        - 提取阶段在线程中逐个文件产出结果，放入有界队列；
+        - 调度阶段为每个文件提交分析请求，在途请求数受信号量限制；
+        - 写入阶段按文件、按注释顺序等待结果并写入报告，保证输出确定性。
+
+        两个队列的容量均为 pipeline_depth，下游变慢时上游自动阻塞（背压），
+        内存占用与仓库规模无关。
+
+        Args:
+            results: 提取结果的迭代器，None 时按 file_path 与 since 提取
+        """
+        dispatcher = Dispatcher(
+            self.analyzer,
+            self.max_concurrency,
+            self.cache,
+            dedup=self.dedup,
+            budget=self.budget,
+        )
+        logger.info(
+            f"Dispatching LLM requests with max {self.max_concurrency} in flight"
+        )
+
+        extracted: asyncio.Queue = asyncio.Queue(maxsize=self.pipeline_depth)
+        scheduled: asyncio.Queue = asyncio.Queue(maxsize=self.pipeline_depth)
+        results = results or self._extract()
+        if self.scorer is not None:
+            results = prioritize(results, self.scorer)
+        async with asyncio.TaskGroup() as group:
+            group.create_task(self._produce(extracted, results))
+            group.create_task(self._schedule(extracted, scheduled, dispatcher, group))
+            group.create_task(self._write(scheduled))
+        dispatcher.log_stats()
+
+    async def _produce(
+        self, extracted: asyncio.Queue, iterator: Iterator[dict[str, Any]]
+    ) -> None:
+        """提取阶段：在线程中驱动提取生成器，避免阻塞事件循环"""
+        while True:
+            comment_info = await asyncio.to_thread(next, iterator, None)
+            await extracted.put(comment_info)
+            if comment_info is None:
+                return
+
+    async def _schedule(
+        self,
+        extracted: asyncio.Queue,
+        scheduled: asyncio.Queue,
+        dispatcher: Dispatcher,
+        group: asyncio.TaskGroup,
+    ) -> None:
+        """调度阶段：查询缓存并按批次为每个文件提交分析请求"""
+        while (comment_info := await extracted.get()) is not None:
             filename = comment_info.get("file", "unknown")
             comments_list = comment_info.get("comments", [])
             logger.info(f"Extracted {len(comments_list)} comments from the {filename}.")
             if not comments_list:
                 logger.warning(f"No comments found in file: {filename}")
                 continue
+            records, comments, contexts = [], [], []
             for comment_dic in comments_list:
                 comment = comment_dic.get("text", "")
                 if comment == "":
                     continue
-                self.analyzer.comments = comment
-                response = self.analyzer.analyze()
-                if "Normal" not in response:
-                    with open(self.save_path, "a") as f:
-                        f.write(f"File:\n {filename}\n")
-                        f.write(f"Comment:\n{comment}\n")
-                        f.write(f"Analysis Result\n{response}\n")
-                        f.write("=" * 80 + "\n")
+                # 关键词模式中代码行的命中不是注释，不经过预过滤，也不送入注释的
+                # 拼写/语法提示词，直接作为命中写入报告
+                is_code = comment_dic.get("type") == "code"
+                if is_code:
+                    context = ""
+                else:
+                    context = self.analyzer.build_context(comment_info, comment_dic)
+                if self.journal is not None and self.journal.is_done(
+                    filename, comment_dic, context
+                ):
+                    continue
+                if (
+                    not is_code
+                    and self.prefilter is not None
+                    and self.prefilter.check(comment_dic)
+                ):
+                    continue
+                records.append(comment_dic)
+                comments.append(comment)
+                contexts.append(context)
+
+            # 缓存命中的注释直接得到结果；与已提交注释重复的复用其批次结果；
+            # 其余按分析器的批次划分提交请求
+            responses: list[Optional[str]] = []
+            keys: list[Optional[str]] = []
+            for comment_dic, comment, context in zip(records, comments, contexts):
+                if comment_dic.get("type") == "code":
+                    responses.append(self._keyword_hit(comment_dic))
+                    keys.append(None)
+                else:
+                    responses.append(dispatcher.lookup(comment, context))
+                    keys.append(dispatcher.dedup_key(comment, context))
+            misses, followers, seen = [], [], set()
+            for i, response in enumerate(responses):
+                if response is not None:
+                    continue
+                key = keys[i]
+                if key is not None and (key in seen or dispatcher.is_submitted(key)):
+                    followers.append(i)
+                    continue
+                if key is not None:
+                    seen.add(key)
+                misses.append(i)
+            tasks = []
+            for batch in self.analyzer.make_batches([comments[i] for i in misses]):
+                indices = [misses[i] for i in batch]
+                if self.budget is not None and not self.budget.admit(len(indices)):
+                    continue
+                task = group.create_task(
+                    dispatcher.analyze_batch(
+                        [comments[i] for i in indices], [contexts[i] for i in indices]
+                    )
+                )
+                dispatcher.register_batch(task, [keys[i] for i in indices])
+                tasks.append((indices, task))
+            # 同一文件内的重复注释在其首次出现所在批次提交后才能找到对应任务；
+            # 首次出现的批次因预算耗尽未提交时，重复注释同样不分析
+            shared = []
+            for i in followers:
+                if not dispatcher.is_submitted(keys[i]):
+                    continue
+                result = dispatcher.shared_result(keys[i])
+                if isinstance(result, str):
+                    responses[i] = result
+                else:
+                    shared.append((i, *result))
+            await scheduled.put(
+                (filename, records, contexts, responses, tasks, shared)
+            )
+        await scheduled.put(None)
+
+    @staticmethod
+    def _keyword_hit(record: dict[str, Any]) -> str:
+        """代码行关键词命中的结论文本"""
+        keywords = ", ".join(record.get("keywords", []))
+        return format_verdict(
+            {"type": "Keyword", "detail": f"Keywords in code: {keywords}"}
+        )
+
+    async def _write(self, scheduled: asyncio.Queue) -> None:
+        """写入阶段：按文件顺序等待分析结果并写入报告"""
+        while (item := await scheduled.get()) is not None:
+            filename, records, contexts, responses, tasks, shared = item
+            for indices, task in tasks:
+                for i, response in zip(indices, await task):
+                    responses[i] = response
+            for i, task, position in shared:
+                responses[i] = (await task)[position]
+            analyzed = sum(r is not None for r in responses)
+            METRICS.counter("comments_analyzed", "Comments with a verdict").inc(
+                analyzed
+            )
+            done = []
+            for comment_dic, context, response in zip(records, contexts, responses):
+                if response is None:
+                    continue
+                verdict = parse_verdict(response)
+                # 无法解析的响应照常报告供人工确认，但不记入检查点，--resume 时重试
+                if verdict is not None:
+                    done.append((comment_dic, context))
+                if is_finding(verdict):
+                    METRICS.counter("findings", "Comments reported as issues").inc()
+                    self.report.add(filename, comment_dic, response)
                     logger.info(f"Analysis Result for {filename}:\n{response}")
-            # FIXME@haifeng: whether analyze all comments together in one file?
-            # total_comment = []
-            # for i, comment_dic in enumerate(comments_list):
-            #     comment = comment_dic.get("text", "")
-            #     total_comment.append(f"## Case{i}\n### Comment\ncomment:{comment}")
-            # all_comments = "\n".join(total_comment)
-            # logger.info(f"{all_comments}")
-            # self.analyzer.comments = all_comments
-            # response = self.analyzer.analyze()
-            # logger.info(f"Analysis completed for file: {filename}")
-            # logger.info(f"Analysis Result for {filename}:\n{response}")
-            # break
+            # 结论先写入报告再记录检查点，中断后不会丢失已记录注释的结论
+            self.report.flush()
+            if self.journal is not None:
+                self.journal.record(filename, done)
+            if self._analyzed is not None:
+                # watch 模式只记下得到结论的注释，失败的注释在下一轮文件变化时重试
+                self._analyzed.setdefault(filename, set()).update(
+                    AnalysisCache.make_key(c.get("text", ""), x) for c, x in done
+                )
+
+    def _extract(self) -> Iterator[dict[str, Any]]:
+        """
+        流式提取注释；指定 since 时只解析变更文件，并只保留与变更 hunk 相交的注释
+        """
+        if self.since is None:
+            yield from self.extractor.iter_parse_file(self.file_path)
+            return
+
+        hunks = changed_hunks(self.file_path, self.since)
+        files = [
+            file
+            for file in self.extractor.collect_files(self.file_path)
+            if file.resolve() in hunks
+        ]
+        logger.info(f"{len(files)} files changed since {self.since}")
+        for result in self.extractor.iter_parse_files(files):
+            ranges = hunks[Path(result["file"]).resolve()]
+            yield filter_changed_comments(result, ranges)
+
+
+def _split(value: str) -> list[str]:
+    """解析逗号分隔的命令行参数"""
+    return [item.strip() for item in value.split(",") if item.strip()]
+
+
+def _parse_shard(value: str) -> tuple[int, int]:
+    """解析 i/N 形式的分片参数（i 从 1 开始），返回从 0 开始的 (序号, 总数)"""
+    try:
+        index, count = (int(part) for part in value.split("/"))
+    except ValueError:
+        raise typer.BadParameter(f"Expected i/N, got {value!r}")
+    if count < 1 or not 1 <= index <= count:
+        raise typer.BadParameter(f"Shard {value!r} out of range")
+    return index - 1, count
 
 
 def main(
@@ -75,35 +402,229 @@ def main(
     ),
     model_name: str = typer.Option("deepseek-chat", help="LLM model name."),
     language: str = typer.Option(
-        "python", help="Programming language of the source code."
+        "python",
+        help="Programming language of the source code, or 'auto' to detect "
+        "it per file from the suffix.",
+    ),
+    extractor_type: str = typer.Option(
+        "comment", help="Type of extractor to use: comment or keyword."
+    ),
+    keywords: str = typer.Option(
+        ",".join(DEFAULT_KEYWORDS),
+        help="Comma-separated keywords matched by the keyword extractor.",
     ),
-    extractor_type: str = typer.Option("comment", help="Type of extractor to use."),
     analyze_type: str = typer.Option(
         "without_context", help="Type of analysis to perform."
     ),
+    triage_model: Optional[str] = typer.Option(
+        None,
+        help="Cheap model that triages every comment; only suspicious ones are "
+        "confirmed by --model-name with context (overrides --analyze-type).",
+    ),
     save_path: Path = typer.Option(
         "output.log", help="Path to save the analysis report."
     ),
+    max_concurrency: Optional[int] = typer.Option(
+        None,
+        help="Max in-flight LLM requests (defaults to max_concurrency in model_config.yaml).",
+    ),
+    batch_size: int = typer.Option(
+        1, help="Max comments packed into one request (without_context only)."
+    ),
+    batch_tokens: Optional[int] = typer.Option(
+        None, help="Approximate token budget of the comments in one batched request."
+    ),
+    cache: bool = typer.Option(
+        True, help="Serve unchanged comments from the on-disk analysis cache."
+    ),
+    cache_path: Path = typer.Option(
+        ANALYSIS_CACHE_PATH, help="Path of the SQLite analysis cache."
+    ),
+    index: bool = typer.Option(
+        True, help="Reuse extraction results of files unchanged since the last run."
+    ),
+    index_path: Path = typer.Option(
+        EXTRACTION_INDEX_PATH, help="Path of the SQLite extraction index."
+    ),
+    watch: bool = typer.Option(
+        False, help="Keep running and re-analyze comments as files change."
+    ),
+    watch_interval: float = typer.Option(
+        DEFAULT_WATCH_INTERVAL, help="Seconds between file polls in watch mode."
+    ),
+    since: Optional[str] = typer.Option(
+        None, help="Only scan comments in lines changed since this git revision."
+    ),
+    workers: int = typer.Option(
+        1, help="Extraction worker processes (0 = all CPU cores)."
+    ),
+    shard: Optional[str] = typer.Option(
+        None,
+        help="Only scan shard i/N of the files (by stable path hash); merge the "
+        "per-shard outputs with `python -m corex.merge`.",
+    ),
+    include: str = typer.Option(
+        "", help="Comma-separated globs; only matching files are scanned."
+    ),
+    exclude: str = typer.Option(
+        "", help="Comma-separated gitignore-style patterns to skip."
+    ),
+    default_excludes: bool = typer.Option(
+        True,
+        help="Skip .git, node_modules, __pycache__, ... anywhere and build, dist, "
+        "third_party, vendor at the scan root.",
+    ),
+    ignore_files: bool = typer.Option(
+        True, help="Honour .gitignore and .corexignore files while walking."
+    ),
+    max_file_size: int = typer.Option(
+        DEFAULT_MAX_FILE_SIZE, help="Skip files larger than this many bytes (0 = no cap)."
+    ),
+    skip_generated: bool = typer.Option(
+        True, help="Skip files marked as generated (@generated, DO NOT EDIT)."
+    ),
+    context_tokens: int = typer.Option(
+        DEFAULT_CONTEXT_TOKENS, help="Token budget of the code context per comment."
+    ),
+    prefilter: bool = typer.Option(
+        True, help="Skip trivially-normal comments (license, directives, ...)."
+    ),
+    prefilter_classifier: Optional[str] = typer.Option(
+        None, help="Local classifier 'module:function' returning P(issue) for text."
+    ),
+    prefilter_threshold: float = typer.Option(
+        0.05, help="Skip comments the classifier scores below this probability."
+    ),
+    dedup: bool = typer.Option(
+        True, help="Analyze identical comments once and fan the verdict out."
+    ),
+    report_format: str = typer.Option(
+        "text",
+        help=f"Comma-separated report formats: {', '.join(REPORT_FORMATS)}. "
+        "Non-text reports are written next to save_path with their own suffix.",
+    ),
+    resume: bool = typer.Option(
+        False, help="Skip comments recorded in the checkpoint journal of a prior run."
+    ),
+    checkpoint_path: Optional[Path] = typer.Option(
+        None, help="Checkpoint journal path (defaults to <save_path>.journal)."
+    ),
+    prioritize: Optional[bool] = typer.Option(
+        None,
+        "--prioritize/--no-prioritize",
+        help="Analyze the highest-risk comments first (default: on when a budget "
+        "is set).",
+    ),
+    blame: bool = typer.Option(
+        False, help="Raise the risk of comments older than their code (git blame)."
+    ),
+    max_requests: Optional[int] = typer.Option(
+        None, help="Stop submitting LLM requests after this many."
+    ),
+    max_tokens: Optional[int] = typer.Option(
+        None, help="Stop submitting LLM requests after this many tokens in + out."
+    ),
+    deadline: Optional[float] = typer.Option(
+        None, help="Stop submitting LLM requests this many seconds into the run."
+    ),
+    metrics_path: Optional[Path] = typer.Option(
+        None, help="Write a JSON run summary (counters, latency histograms) here."
+    ),
+    prometheus_path: Optional[Path] = typer.Option(
+        None, help="Write metrics in Prometheus textfile format here."
+    ),
 ):
     llms = LLM(model_name=model_name)
+    path_filter = PathFilter(
+        include=_split(include),
+        exclude=_split(exclude),
+        exclude_dirs=DEFAULT_EXCLUDE_DIRS if default_excludes else (),
+        root_exclude_dirs=DEFAULT_ROOT_EXCLUDE_DIRS if default_excludes else (),
+        ignore_files=IGNORE_FILES if ignore_files else (),
+        max_file_size=max_file_size,
+        skip_generated=skip_generated,
+        shard=_parse_shard(shard) if shard else None,
+    )
+    if path_filter.shard is not None:
+        logger.info(f"Scanning shard {shard} of {file_path}")
+    extraction_index = ExtractionIndex(index_path) if index else None
     if extractor_type == "comment":
-        extractor = CommentExtractor(language=language)
-    elif extractor_type == "keyword":  # TODO@haifeng
-        extractor = KeywordExtractor(language=language)
+        extractor = CommentExtractor(
+            language=language,
+            workers=workers,
+            path_filter=path_filter,
+            index=extraction_index,
+        )
+    elif extractor_type == "keyword":
+        extractor = KeywordExtractor(
+            language=language,
+            keywords=_split(keywords),
+            workers=workers,
+            path_filter=path_filter,
+            index=extraction_index,
+        )
     else:
         raise ValueError(f"Unsupported extractor type: {extractor_type}")
 
-    if analyze_type == "without_context":
-        analyzer = AnalyzerWithoutContext(llms=llms)
+    if triage_model is not None:
+        # 级联模式：分流模型批量判断全部注释，可疑的注释由 model_name 结合上下文确认
+        analyzer = CascadeAnalyzer(
+            triage=AnalyzerWithoutContext(
+                llms=LLM(model_name=triage_model),
+                batch_size=batch_size,
+                batch_tokens=batch_tokens,
+            ),
+            confirm=AnalyzerWithContext(llms=llms, context_tokens=context_tokens),
+        )
+    elif analyze_type == "without_context":
+        analyzer = AnalyzerWithoutContext(
+            llms=llms, batch_size=batch_size, batch_tokens=batch_tokens
+        )
     elif analyze_type == "with_context":  # TODO@haifeng
-        analyzer = AnalyzerWithContext(llms=llms)
+        analyzer = AnalyzerWithContext(llms=llms, context_tokens=context_tokens)
     else:
         raise ValueError(f"Unsupported analyze type: {analyze_type}")
 
+    comment_filter = None
+    if prefilter:
+        comment_filter = PreFilter()
+        if prefilter_classifier:
+            comment_filter.rules.append(
+                ClassifierRule.from_spec(prefilter_classifier, prefilter_threshold)
+            )
+
+    budget = None
+    if max_requests is not None or max_tokens is not None or deadline is not None:
+        budget = Budget(analyzer.usages, max_requests, max_tokens, deadline)
+    if prioritize is None:
+        prioritize = budget is not None
+
     corex = CoRex(
-        file_path=file_path, extractor=extractor, analyzer=analyzer, save_path=save_path
+        file_path=file_path,
+        extractor=extractor,
+        analyzer=analyzer,
+        save_path=save_path,
+        max_concurrency=max_concurrency,
+        cache=AnalysisCache(cache_path) if cache else None,
+        since=since,
+        prefilter=comment_filter,
+        dedup=dedup,
+        report=ReportSink.from_formats(
+            save_path, _split(report_format), resume=resume
+        ),
+        journal=CheckpointJournal(
+            checkpoint_path or save_path.with_name(save_path.name + ".journal"),
+            resume=resume,
+        ),
+        metrics_path=metrics_path,
+        prometheus_path=prometheus_path,
+        scorer=RiskScorer(blame=blame) if prioritize else None,
+        budget=budget,
     )
-    corex.run()
+    if watch:
+        corex.watch(watch_interval)
+    else:
+        corex.run()
 
 
 # python -m corex.main --file-path /path/to/code --model-name deepseek-chat --language python --extractor-type comment --analyze-type without_context
@@ -0,0 +1,137 @@
+import json
+from pathlib import Path
+from typing import Any, Optional
+
+import typer
+from loguru import logger
+
+from .cache import AnalysisCache
+from .config import ANALYSIS_CACHE_PATH
+from .metrics import MetricsRegistry
+from .report import REPORT_FORMATS, ReportSink
+
+
+def load_findings(paths: list[Path]) -> list[dict[str, Any]]:
+    """
+    读入各分片的 JSONL 报告，去重并按 (文件, 起始行) 排序
+
+    分片按文件划分，正常情况下不会重复；同一分片重跑（如 CI 重试）后两份报告
+    都被传入时，同一位置的同一注释只保留第一条。被中断的运行可能留下写了一半的
+    末行，跳过并给出警告。
+    """
+    findings: dict[tuple, dict[str, Any]] = {}
+    for path in paths:
+        with open(path, "r", encoding="utf-8") as f:
+            for lineno, line in enumerate(f, 1):
+                if not line.strip():
+                    continue
+                try:
+                    finding = json.loads(line)
+                except json.JSONDecodeError:
+                    logger.warning(f"Skipping malformed line {lineno} of {path}")
+                    continue
+                key = (
+                    finding.get("file"),
+                    finding.get("start_line"),
+                    finding.get("end_line"),
+                    finding.get("comment"),
+                )
+                findings.setdefault(key, finding)
+    return sorted(
+        findings.values(),
+        key=lambda f: (str(f.get("file")), f.get("start_line") or 0),
+    )
+
+
+def merge_reports(paths: list[Path], save_path: Path, formats: list[str]) -> int:
+    """
+    合并分片报告并按 formats 重新生成（SARIF 等整体格式由全部结论重新写出）
+
+    Returns:
+        合并后的结论数
+    """
+    # 先读入全部输入再创建输出（非 resume 模式清空旧文件），输出可以与输入同名
+    findings = load_findings(paths)
+    sink = ReportSink.from_formats(save_path, formats)
+    for finding in findings:
+        sink.write(finding)
+    sink.close()
+    return len(findings)
+
+
+def merge_caches(paths: list[Path], cache_path: Path) -> int:
+    """
+    把各分片的分析缓存合并到 cache_path
+
+    提取索引按文件的绝对路径与 mtime 记录，只在本机有效，不参与合并；
+    分片按路径哈希稳定划分，各节点保留自己的索引即可。
+
+    Returns:
+        新增的缓存条目数
+    """
+    cache = AnalysisCache(cache_path)
+    added = 0
+    try:
+        for path in paths:
+            if Path(path).resolve() == cache.path.resolve():
+                continue
+            added += cache.merge(path)
+    finally:
+        cache.close()
+    return added
+
+
+def merge_metrics(paths: list[Path]) -> MetricsRegistry:
+    """合并各分片 --metrics-path 写出的 JSON 摘要"""
+    registry = MetricsRegistry()
+    for path in paths:
+        with open(path, "r", encoding="utf-8") as f:
+            registry.merge(json.load(f))
+    return registry
+
+
+def main(
+    report: list[Path] = typer.Option(
+        [], help="Per-shard JSONL report (repeat for each shard)."
+    ),
+    save_path: Path = typer.Option("output.log", help="Path of the merged report."),
+    report_format: str = typer.Option(
+        "text,jsonl",
+        help="Comma-separated formats of the merged report: "
+        f"{', '.join(REPORT_FORMATS)}.",
+    ),
+    cache: list[Path] = typer.Option(
+        [], help="Per-shard SQLite analysis cache (repeat for each shard)."
+    ),
+    cache_path: Path = typer.Option(
+        ANALYSIS_CACHE_PATH, help="Analysis cache the shard caches are merged into."
+    ),
+    metrics: list[Path] = typer.Option(
+        [], help="Per-shard JSON metrics summary (repeat for each shard)."
+    ),
+    metrics_path: Optional[Path] = typer.Option(
+        None, help="Write the merged JSON metrics summary here."
+    ),
+    prometheus_path: Optional[Path] = typer.Option(
+        None, help="Write the merged metrics in Prometheus textfile format here."
+    ),
+):
+    if report:
+        formats = [name.strip() for name in report_format.split(",") if name.strip()]
+        count = merge_reports(report, save_path, formats)
+        logger.info(f"Merged {count} findings from {len(report)} reports")
+    if cache:
+        added = merge_caches(cache, cache_path)
+        logger.info(f"Merged {len(cache)} caches into {cache_path} (+{added} entries)")
+    if metrics:
+        registry = merge_metrics(metrics)
+        registry.log_summary()
+        if metrics_path is not None:
+            registry.write_json(metrics_path)
+        if prometheus_path is not None:
+            registry.write_prometheus(prometheus_path)
+
+
+# python -m corex.merge --report shard1/output.jsonl --report shard2/output.jsonl --save-path output.log --report-format text,jsonl,sarif
+if __name__ == "__main__":
+    typer.run(main)
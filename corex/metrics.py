@@ -0,0 +1,245 @@
+import bisect
+import json
+import math
+import threading
+import time
+from contextlib import contextmanager
+from pathlib import Path
+from typing import Any, Iterator, Optional
+
+from loguru import logger
+
+# 指数分布的直方图桶上界（秒）：1ms ~ 约 9 分钟，相邻桶相差一倍
+DEFAULT_BUCKETS = tuple(0.001 * 2**i for i in range(20))
+# 运行摘要中输出的分位数
+SUMMARY_QUANTILES = (0.5, 0.95, 0.99)
+
+
+class Counter:
+    """单调递增的计数器"""
+
+    def __init__(self, help: str = ""):
+        self.help = help
+        self.value = 0
+
+    def inc(self, amount: float = 1) -> None:
+        self.value += amount
+
+
+class Histogram:
+    """
+    固定桶的直方图
+
+    只保存每个桶的计数，内存占用与样本数无关；桶边界相同的直方图可以直接合并
+    （例如多个分片的运行结果），分位数在桶内线性插值估算。
+    """
+
+    def __init__(self, help: str = "", buckets: tuple[float, ...] = DEFAULT_BUCKETS):
+        self.help = help
+        self.buckets = buckets
+        # 最后一个桶收集超过最大上界的样本
+        self.counts = [0] * (len(buckets) + 1)
+        self.count = 0
+        self.sum = 0.0
+        self.min = math.inf
+        self.max = -math.inf
+
+    def observe(self, value: float) -> None:
+        self.counts[bisect.bisect_left(self.buckets, value)] += 1
+        self.count += 1
+        self.sum += value
+        self.min = min(self.min, value)
+        self.max = max(self.max, value)
+
+    def merge(self, other: "Histogram") -> None:
+        if other.buckets != self.buckets:
+            raise ValueError("Cannot merge histograms with different buckets")
+        self.counts = [a + b for a, b in zip(self.counts, other.counts)]
+        self.count += other.count
+        self.sum += other.sum
+        self.min = min(self.min, other.min)
+        self.max = max(self.max, other.max)
+
+    def quantile(self, q: float) -> Optional[float]:
+        if not self.count:
+            return None
+        rank = q * self.count
+        seen = 0
+        for i, count in enumerate(self.counts):
+            if count and seen + count >= rank:
+                lower = self.buckets[i - 1] if i > 0 else 0.0
+                upper = self.buckets[i] if i < len(self.buckets) else self.max
+                lower, upper = max(lower, self.min), min(upper, self.max)
+                return lower + (upper - lower) * (rank - seen) / count
+            seen += count
+        return self.max
+
+    def summary(self) -> dict[str, Any]:
+        if not self.count:
+            return {"count": 0}
+        summary = {
+            "count": self.count,
+            "sum": self.sum,
+            "mean": self.sum / self.count,
+            "min": self.min,
+            "max": self.max,
+        }
+        for q in SUMMARY_QUANTILES:
+            summary[f"p{round(q * 100)}"] = self.quantile(q)
+        return summary
+
+    def to_dict(self) -> dict[str, Any]:
+        """可合并的完整表示，包含各桶计数"""
+        return {**self.summary(), "buckets": list(self.buckets), "counts": self.counts}
+
+    @classmethod
+    def from_dict(cls, data: dict[str, Any]) -> "Histogram":
+        histogram = cls(buckets=tuple(data["buckets"]))
+        histogram.counts = list(data["counts"])
+        histogram.count = data["count"]
+        histogram.sum = data.get("sum", 0.0)
+        histogram.min = data.get("min", math.inf)
+        histogram.max = data.get("max", -math.inf)
+        return histogram
+
+
+class MetricsRegistry:
+    """
+    进程内的指标注册表，各模块按名称取得计数器/直方图并记录
+
+    多进程提取时 worker 中的耗时随提取结果带回主进程再记录，
+    因此注册表只需要在主进程内汇总。
+    """
+
+    def __init__(self):
+        self.counters: dict[str, Counter] = {}
+        self.histograms: dict[str, Histogram] = {}
+        self.started = time.perf_counter()
+        # 合并分片结果时固定的运行耗时，None 表示按 started 计算
+        self.elapsed: Optional[float] = None
+        self._lock = threading.Lock()
+
+    def counter(self, name: str, help: str = "") -> Counter:
+        with self._lock:
+            if name not in self.counters:
+                self.counters[name] = Counter(help)
+            return self.counters[name]
+
+    def histogram(self, name: str, help: str = "") -> Histogram:
+        with self._lock:
+            if name not in self.histograms:
+                self.histograms[name] = Histogram(help)
+            return self.histograms[name]
+
+    @contextmanager
+    def time(self, name: str) -> Iterator[None]:
+        """记录 with 代码块的耗时（秒）到直方图 name"""
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.histogram(name).observe(time.perf_counter() - start)
+
+    def reset(self) -> None:
+        with self._lock:
+            self.counters.clear()
+            self.histograms.clear()
+            self.started = time.perf_counter()
+            self.elapsed = None
+
+    def merge(self, summary: dict[str, Any]) -> None:
+        """
+        合并另一次运行（如另一个分片）的 summary()：计数器相加、直方图按桶合并，
+        各分片并行运行，耗时取最大值
+        """
+        for name, value in summary.get("counters", {}).items():
+            self.counter(name).inc(value)
+        for name, data in summary.get("histograms", {}).items():
+            self.histogram(name).merge(Histogram.from_dict(data))
+        self.elapsed = max(self.elapsed or 0.0, summary.get("elapsed_seconds", 0.0))
+
+    def summary(self) -> dict[str, Any]:
+        """
+        生成运行摘要
+
+        Returns:
+            运行耗时、吞吐、所有计数器与直方图（含各桶计数，可跨分片合并）
+        """
+        elapsed = self.elapsed
+        if elapsed is None:
+            elapsed = time.perf_counter() - self.started
+        counters = {name: c.value for name, c in sorted(self.counters.items())}
+        rate = (lambda n: n / elapsed) if elapsed > 0 else (lambda n: 0.0)
+        return {
+            "elapsed_seconds": elapsed,
+            "throughput": {
+                "files_per_second": rate(counters.get("files_parsed", 0)),
+                "comments_per_second": rate(counters.get("comments_analyzed", 0)),
+            },
+            "counters": counters,
+            "histograms": {
+                name: h.to_dict() for name, h in sorted(self.histograms.items())
+            },
+        }
+
+    def log_summary(self) -> None:
+        summary = self.summary()
+        counters = summary["counters"]
+        logger.info(
+            f"Run summary: {counters.get('files_parsed', 0)} files, "
+            f"{counters.get('comments_analyzed', 0)} comments analyzed in "
+            f"{summary['elapsed_seconds']:.1f}s "
+            f"({summary['throughput']['comments_per_second']:.2f} comments/s)"
+        )
+        for name in ("parse_seconds", "llm_latency_seconds"):
+            histogram = self.histograms.get(name)
+            if histogram is None or not histogram.count:
+                continue
+            p50, p95, p99 = (histogram.quantile(q) for q in SUMMARY_QUANTILES)
+            logger.info(
+                f"{name}: p50={p50:.3f}s p95={p95:.3f}s p99={p99:.3f}s "
+                f"(n={histogram.count})"
+            )
+
+    def write_json(self, path: Path) -> None:
+        path = Path(path)
+        path.parent.mkdir(parents=True, exist_ok=True)
+        with open(path, "w", encoding="utf-8") as f:
+            json.dump(self.summary(), f, indent=2)
+        logger.info(f"Metrics summary written to {path}")
+
+    def write_prometheus(self, path: Path) -> None:
+        """
+        以 Prometheus 文本格式写出指标，可由 node_exporter 的 textfile collector 采集
+        """
+        lines = []
+        for name, counter in sorted(self.counters.items()):
+            metric = f"corex_{name}_total"
+            if counter.help:
+                lines.append(f"# HELP {metric} {counter.help}")
+            lines.append(f"# TYPE {metric} counter")
+            lines.append(f"{metric} {counter.value}")
+        for name, histogram in sorted(self.histograms.items()):
+            metric = f"corex_{name}"
+            if histogram.help:
+                lines.append(f"# HELP {metric} {histogram.help}")
+            lines.append(f"# TYPE {metric} histogram")
+            cumulative = 0
+            for bound, count in zip(histogram.buckets, histogram.counts):
+                cumulative += count
+                lines.append(f'{metric}_bucket{{le="{bound:g}"}} {cumulative}')
+            lines.append(f'{metric}_bucket{{le="+Inf"}} {histogram.count}')
+            lines.append(f"{metric}_sum {histogram.sum}")
+            lines.append(f"{metric}_count {histogram.count}")
+
+        path = Path(path)
+        path.parent.mkdir(parents=True, exist_ok=True)
+        # 先写临时文件再替换，避免采集端读到写了一半的文件
+        tmp = path.with_name(path.name + ".tmp")
+        tmp.write_text("\n".join(lines) + "\n", encoding="utf-8")
+        tmp.replace(path)
+        logger.info(f"Prometheus metrics written to {path}")
+
+
+# 全局注册表，供各模块直接记录
+METRICS = MetricsRegistry()
@@ -0,0 +1,181 @@
+import importlib
+import re
+from abc import ABC, abstractmethod
+from collections import Counter
+from typing import Any, Callable, Optional
+
+from loguru import logger
+
+from .metrics import METRICS
+from .utils.text import strip_comment_markers
+
+
+class PreFilterRule(ABC):
+    """预过滤规则：命中的注释被视为无风险，不发送给 LLM"""
+
+    name = "rule"
+
+    @abstractmethod
+    def match(self, body: str, comment: dict[str, Any]) -> bool:
+        """
+        Args:
+            body: 去掉注释标记后的注释正文
+            comment: 注释信息字典
+
+        Returns:
+            True 表示跳过该注释
+        """
+        raise NotImplementedError()
+
+
+class LicenseHeaderRule(PreFilterRule):
+    """
+    文件头中的版权与许可证声明
+
+    只匹配文件开头注释块（提取器标记的 header）中的注释，正文中提到
+    copyright / license 的注释仍然需要分析。
+    """
+
+    name = "license"
+    PATTERN = re.compile(
+        r"copyright\b|spdx-license-identifier|licensed under|all rights reserved"
+        r"|permission is hereby granted|apache license|gnu (?:lesser )?general public",
+        re.IGNORECASE,
+    )
+
+    def match(self, body: str, comment: dict[str, Any]) -> bool:
+        return bool(comment.get("header")) and bool(self.PATTERN.search(body))
+
+
+class SuppressionDirectiveRule(PreFilterRule):
+    """工具指令：noqa、type: ignore、NOLINT、clang-format、编码声明与 shebang 等"""
+
+    name = "directive"
+    PATTERN = re.compile(
+        r"^(?:noqa\b|type:\s*ignore|pylint:|mypy:|pyright:|fmt:\s*(?:on|off|skip)"
+        r"|isort:|ruff:|codespell:ignore|nolint|clang-format\s+(?:on|off)"
+        r"|eslint-disable|pragma\b|-\*-.*-\*-$|!/|cython:|nvcc\b)",
+        re.IGNORECASE,
+    )
+
+    def match(self, body: str, comment: dict[str, Any]) -> bool:
+        return bool(self.PATTERN.match(body))
+
+
+class NoProseRule(PreFilterRule):
+    """没有自然语言的注释：分隔线、纯数字、单独的 URL"""
+
+    name = "no_prose"
+    # 任意文字的字母（含中日韩文字），不含数字与下划线
+    WORD = re.compile(r"[^\W\d_]{2,}")
+    URL = re.compile(r"^<?https?://\S+>?$")
+
+    def match(self, body: str, comment: dict[str, Any]) -> bool:
+        return not self.WORD.search(body) or bool(self.URL.match(body))
+
+
+class DoxygenTagRule(PreFilterRule):
+    """
+    只有 Doxygen 标签骨架（如 `@param x`、`\\return`）而没有说明文字的注释块
+
+    每个标签之后最多只能有一个参数名，参数名之后的任何说明文字都交给 LLM 检查，
+    例如 `@param n numbr` 中的拼写错误。
+    """
+
+    name = "doxygen"
+    # @param[in] x 中的方向标注属于标签本身
+    TAG = re.compile(r"^[@\\](\w+)(?:\[[^\]]*\])?\s*(.*)$")
+    # 以参数名为第一个词的标签
+    NAMED_TAGS = frozenset(("param", "tparam", "throws", "throw", "exception", "retval"))
+
+    def match(self, body: str, comment: dict[str, Any]) -> bool:
+        lines = [line.strip() for line in body.split("\n") if line.strip()]
+        if not lines:
+            return False
+        for line in lines:
+            tag = self.TAG.match(line)
+            if tag is None:
+                return False
+            words = tag.group(2).split()
+            if tag.group(1) in self.NAMED_TAGS:
+                words = words[1:]
+            if any(NoProseRule.WORD.search(word) for word in words):
+                return False
+        return True
+
+
+class ClassifierRule(PreFilterRule):
+    """
+    本地分类器规则：classifier(text) 返回注释存在问题的概率，
+    低于阈值时跳过。可接入小型本地模型或基于 embedding 的分类器。
+    """
+
+    name = "classifier"
+
+    def __init__(self, classifier: Callable[[str], float], threshold: float = 0.05):
+        self.classifier = classifier
+        self.threshold = threshold
+
+    def match(self, body: str, comment: dict[str, Any]) -> bool:
+        return self.classifier(body) < self.threshold
+
+    @classmethod
+    def from_spec(cls, spec: str, threshold: float = 0.05) -> "ClassifierRule":
+        """
+        按 "package.module:function" 加载分类器
+        """
+        module_name, _, attr = spec.partition(":")
+        if not attr:
+            raise ValueError(f"Classifier spec must be 'module:function', got {spec}")
+        classifier = getattr(importlib.import_module(module_name), attr)
+        return cls(classifier, threshold)
+
+
+def default_rules() -> list[PreFilterRule]:
+    return [
+        LicenseHeaderRule(),
+        SuppressionDirectiveRule(),
+        NoProseRule(),
+        DoxygenTagRule(),
+    ]
+
+
+class PreFilter:
+    """
+    提取器与分析器之间的预过滤阶段
+
+    按顺序应用规则，第一个命中的规则决定跳过原因，并统计各规则的跳过数量。
+    """
+
+    def __init__(self, rules: Optional[list[PreFilterRule]] = None):
+        self.rules = default_rules() if rules is None else rules
+        self.total = 0
+        self.skipped: Counter[str] = Counter()
+
+    def check(self, comment: dict[str, Any]) -> Optional[str]:
+        """
+        Args:
+            comment: 注释信息字典
+
+        Returns:
+            命中的规则名称，未命中返回 None
+        """
+        self.total += 1
+        body = strip_comment_markers(comment.get("text", ""))
+        for rule in self.rules:
+            if rule.match(body, comment):
+                self.skipped[rule.name] += 1
+                METRICS.counter(
+                    "comments_prefiltered", "Comments skipped by the pre-filter"
+                ).inc()
+                return rule.name
+        return None
+
+    def log_stats(self) -> None:
+        skipped = sum(self.skipped.values())
+        ratio = skipped / self.total if self.total else 0.0
+        detail = ", ".join(f"{name}={n}" for name, n in self.skipped.most_common())
+        logger.info(
+            f"Pre-filter skipped {skipped}/{self.total} comments ({ratio:.1%})"
+            + (f": {detail}" if detail else "")
+        )
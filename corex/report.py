@@ -0,0 +1,279 @@
+import json
+from abc import ABC, abstractmethod
+from pathlib import Path
+from typing import Any
+from urllib.parse import quote
+
+from loguru import logger
+
+from .verdict import parse_verdict
+
+REPORT_FORMATS = ("text", "jsonl", "sarif")
+
+
+class ReportWriter(ABC):
+    """报告输出格式，持有一个缓冲的文件句柄，由 ReportSink 统一刷新"""
+
+    suffix = ""
+
+    def __init__(self, path: Path, resume: bool = False):
+        """
+        Args:
+            path: 报告路径
+            resume: 是否接着上一次运行的报告继续写
+        """
+        self.path = Path(path)
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+
+    @abstractmethod
+    def write(self, finding: dict[str, Any]) -> None:
+        raise NotImplementedError()
+
+    def flush(self) -> None:
+        pass
+
+    def close(self) -> None:
+        pass
+
+
+class TextReportWriter(ReportWriter):
+    """人类可读的日志格式（与历史 output.log 格式一致），resume 时追加写入"""
+
+    suffix = ".log"
+
+    def __init__(self, path: Path, resume: bool = False):
+        super().__init__(path, resume)
+        # 非 resume 模式重新开始，与检查点日志一致地清空旧报告
+        self.file = open(
+            self.path, "a" if resume else "w", encoding="utf-8", buffering=1 << 16
+        )
+
+    def write(self, finding: dict[str, Any]) -> None:
+        self.file.write(f"File:\n {finding['file']}\n")
+        self.file.write(f"Comment:\n{finding['comment']}\n")
+        self.file.write(f"Analysis Result\n{finding['response']}\n")
+        self.file.write("=" * 80 + "\n")
+
+    def flush(self) -> None:
+        self.file.flush()
+
+    def close(self) -> None:
+        self.file.close()
+
+
+class JsonlReportWriter(ReportWriter):
+    """每行一个 JSON 结论，扫描过程中即可被下游工具增量消费"""
+
+    suffix = ".jsonl"
+
+    def __init__(self, path: Path, resume: bool = False):
+        super().__init__(path, resume)
+        self.file = open(
+            self.path, "a" if resume else "w", encoding="utf-8", buffering=1 << 16
+        )
+
+    def write(self, finding: dict[str, Any]) -> None:
+        self.file.write(json.dumps(finding, ensure_ascii=False) + "\n")
+
+    def flush(self) -> None:
+        self.file.flush()
+
+    def close(self) -> None:
+        self.file.close()
+
+
+class SarifReportWriter(ReportWriter):
+    """
+    SARIF 2.1.0 报告；SARIF 是单个 JSON 文档，在 close 时整体写出
+
+    resume 时先载入已有报告中的结果，与 text / JSONL 报告的追加写入保持一致，
+    上一次运行的结论不会在续扫后丢失。
+
+    代码扫描平台按仓库相对路径匹配文件：工作目录下的文件写成以 / 分隔的相对 URI，
+    并通过 uriBaseId 指向工作目录；工作目录之外的文件写成绝对 file URI。
+    """
+
+    suffix = ".sarif"
+    uri_base_id = "SRCROOT"
+
+    def __init__(self, path: Path, resume: bool = False):
+        super().__init__(path, resume)
+        self.root = Path.cwd()
+        self.results: list[dict[str, Any]] = []
+        self.rules: dict[str, dict[str, Any]] = {}
+        if resume and self.path.exists():
+            self._load()
+
+    def _load(self) -> None:
+        try:
+            with open(self.path, "r", encoding="utf-8") as f:
+                run = json.load(f)["runs"][0]
+        except (OSError, json.JSONDecodeError, KeyError, IndexError) as e:
+            logger.warning(f"Cannot load previous SARIF report {self.path}: {e!s}")
+            return
+        self.results = list(run.get("results", []))
+        for rule in run.get("tool", {}).get("driver", {}).get("rules", []):
+            self.rules[rule["id"]] = rule
+        logger.info(f"Loaded {len(self.results)} results from {self.path}")
+
+    def _artifact_location(self, filename: str) -> dict[str, str]:
+        path = Path(filename)
+        if path.is_absolute():
+            try:
+                path = path.relative_to(self.root)
+            except ValueError:
+                return {"uri": path.as_uri()}
+        return {"uri": quote(path.as_posix()), "uriBaseId": self.uri_base_id}
+
+    def write(self, finding: dict[str, Any]) -> None:
+        verdict = finding.get("verdict") or {}
+        # 注释本身没有问题、只有代码结论时，以代码结论的类型作为规则
+        code = verdict.get("code") or {}
+        if verdict.get("type") == "Normal" and code.get("type"):
+            verdict = code
+        rule_id = str(verdict.get("type") or "CommentIssue")
+        self.rules.setdefault(
+            rule_id, {"id": rule_id, "shortDescription": {"text": rule_id}}
+        )
+        result: dict[str, Any] = {
+            "ruleId": rule_id,
+            "level": "warning",
+            "message": {"text": verdict.get("detail") or finding["response"]},
+            "locations": [
+                {
+                    "physicalLocation": {
+                        "artifactLocation": self._artifact_location(
+                            finding["file"]
+                        ),
+                        "region": {
+                            "startLine": finding["start_line"],
+                            "endLine": finding["end_line"],
+                        },
+                    }
+                }
+            ],
+        }
+        if verdict.get("replacement"):
+            result["properties"] = {"replacement": verdict["replacement"]}
+        self.results.append(result)
+
+    def close(self) -> None:
+        sarif = {
+            "$schema": "https://json.schemastore.org/sarif-2.1.0.json",
+            "version": "2.1.0",
+            "runs": [
+                {
+                    "tool": {
+                        "driver": {
+                            "name": "CoRex",
+                            "informationUri": "https://github.com/lingebeng/CoRex",
+                            "rules": list(self.rules.values()),
+                        }
+                    },
+                    "originalUriBaseIds": {
+                        self.uri_base_id: {"uri": self.root.as_uri() + "/"}
+                    },
+                    "results": self.results,
+                }
+            ],
+        }
+        with open(self.path, "w", encoding="utf-8") as f:
+            json.dump(sarif, f, ensure_ascii=False, indent=2)
+
+
+WRITERS: dict[str, type[ReportWriter]] = {
+    "text": TextReportWriter,
+    "jsonl": JsonlReportWriter,
+    "sarif": SarifReportWriter,
+}
+
+
+def report_paths(save_path: Path, formats: list[str]) -> list[Path]:
+    """
+    各格式的报告路径：text 写入 save_path，其余格式替换 save_path 的后缀
+
+    save_path 的后缀恰好是其它格式的后缀时（如 --save-path out.jsonl 同时输出
+    text 与 jsonl），两种格式会写入同一个文件，此时抛出 ValueError。
+    """
+    paths: dict[Path, str] = {}
+    for name in formats:
+        if name not in WRITERS:
+            raise ValueError(f"Unsupported report format: {name}")
+        if name == "text":
+            path = Path(save_path)
+        else:
+            path = Path(save_path).with_suffix(WRITERS[name].suffix)
+        if path in paths:
+            raise ValueError(
+                f"Report formats {paths[path]} and {name} both write to {path}"
+            )
+        paths[path] = name
+    return list(paths)
+
+
+class ReportSink:
+    """
+    报告输出汇聚点
+
+    所有格式共用一次 add()，写入缓冲的文件句柄；由调用方在每个文件的结论写完后
+    调用 flush，避免每条结论都打开/关闭文件。
+    """
+
+    def __init__(self, writers: list[ReportWriter]):
+        self.writers = writers
+        self.count = 0
+
+    @classmethod
+    def from_formats(
+        cls, save_path: Path, formats: list[str], resume: bool = False
+    ) -> "ReportSink":
+        """
+        按格式名创建输出，text 写入 save_path，其余格式替换 save_path 的后缀
+
+        Args:
+            save_path: 文本报告路径，如 output.log
+            formats: 格式名列表，取值见 REPORT_FORMATS
+            resume: 是否接着上一次运行（--resume）的报告继续写
+        """
+        paths = report_paths(save_path, formats)
+        return cls(
+            [WRITERS[name](path, resume) for name, path in zip(formats, paths)]
+        )
+
+    def add(self, filename: str, comment: dict[str, Any], response: str) -> None:
+        """
+        记录一条结论
+
+        Args:
+            filename: 注释所在文件
+            comment: 注释信息字典
+            response: LLM 的分析结果
+        """
+        finding = {
+            "file": filename,
+            "start_line": comment.get("start_line"),
+            "end_line": comment.get("end_line"),
+            "comment_type": comment.get("type"),
+            "comment": comment.get("text", ""),
+            "verdict": parse_verdict(response),
+            "response": response,
+        }
+        self.write(finding)
+
+    def write(self, finding: dict[str, Any]) -> None:
+        """记录一条已组装好的结论（如合并分片报告时读入的 JSONL 记录）"""
+        for writer in self.writers:
+            writer.write(finding)
+        self.count += 1
+
+    def flush(self) -> None:
+        for writer in self.writers:
+            writer.flush()
+
+    def close(self) -> None:
+        for writer in self.writers:
+            writer.close()
+        logger.info(
+            f"Wrote {self.count} findings to "
+            + ", ".join(str(w.path) for w in self.writers)
+        )
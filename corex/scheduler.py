@@ -0,0 +1,240 @@
+import re
+import time
+from pathlib import Path
+from typing import Any, Iterable, Iterator, Mapping, Optional, Sequence
+
+from loguru import logger
+
+from .config import (
+    DEFAULT_PRIORITY_WINDOW,
+    KERNEL_RISK_WEIGHT,
+    RISK_KEYWORDS,
+    STALENESS_RISK_WEIGHT,
+)
+from .extractor import scope_chain
+from .llms import TokenUsage
+from .metrics import METRICS
+from .utils.git import blame_times
+
+# 模块级注释没有作用域时，视其后这么多行为它描述的代码
+STALENESS_NEIGHBOURHOOD = 10
+SECONDS_PER_DAY = 86400
+
+
+class RiskScorer:
+    """
+    注释风险的廉价打分，不调用 LLM
+
+    分数由三部分累加：注释中的风险词（RISK_KEYWORDS 权重之和）、注释位于
+    CUDA kernel 中、以及可选的陈旧度——注释最后修改时间早于其所描述代码的
+    最后修改时间（git blame），代码改过而注释没跟着改的注释更可能已经过时。
+    """
+
+    def __init__(
+        self,
+        keywords: Mapping[str, float] = RISK_KEYWORDS,
+        kernel_weight: float = KERNEL_RISK_WEIGHT,
+        blame: bool = False,
+        staleness_weight: float = STALENESS_RISK_WEIGHT,
+    ):
+        """
+        Args:
+            keywords: 风险词到权重的映射
+            kernel_weight: 位于 kernel 中的加分
+            blame: 是否用 git blame 计算陈旧度（每个文件执行一次 git blame）
+            staleness_weight: 陈旧度加分上限
+        """
+        self.weights = {word.lower(): weight for word, weight in keywords.items()}
+        self.pattern = re.compile(
+            "|".join(
+                rf"\b{re.escape(word)}\b"
+                for word in sorted(self.weights, key=len, reverse=True)
+            ),
+            re.IGNORECASE,
+        )
+        self.kernel_weight = kernel_weight
+        self.blame = blame
+        self.staleness_weight = staleness_weight
+        # 文件 -> 每行的最后修改时间，blame 失败（不在仓库中）时为空列表
+        self._blame: dict[str, list[int]] = {}
+
+    def score(self, file_result: dict[str, Any], comment: dict[str, Any]) -> float:
+        text = comment.get("text", "")
+        words = {m.group(0).lower() for m in self.pattern.finditer(text)}
+        score = sum((self.weights[word] for word in words), 0.0)
+        chain = scope_chain(file_result, comment.get("scope_id"))
+        if any(scope.get("type") == "kernel" for scope in chain):
+            score += self.kernel_weight
+        if self.blame:
+            score += self._staleness(file_result["file"], comment, chain)
+        return score
+
+    def release(self, filename: str) -> None:
+        """文件的注释都已打分后释放其 blame 结果"""
+        self._blame.pop(filename, None)
+
+    def _staleness(
+        self, filename: str, comment: dict[str, Any], chain: list[dict]
+    ) -> float:
+        if filename not in self._blame:
+            try:
+                self._blame[filename] = blame_times(Path(filename))
+            except (OSError, RuntimeError) as e:
+                logger.debug(f"No blame for {filename}: {e!s}")
+                self._blame[filename] = []
+        times = self._blame[filename]
+        if not times:
+            return 0.0
+
+        # blame 对应磁盘上的已提交版本，与提取时的内容行数可能不一致，行号都限制在范围内
+        start, end = comment["start_line"], comment["end_line"]
+        if chain:
+            code_start, code_end = chain[-1]["start_line"], chain[-1]["end_line"]
+        else:
+            code_start, code_end = end + 1, end + STALENESS_NEIGHBOURHOOD
+        code = [
+            times[line - 1]
+            for line in range(max(code_start, 1), min(code_end, len(times)) + 1)
+            if not start <= line <= end
+        ]
+        lines = range(max(start, 1), min(end, len(times)) + 1)
+        if not code or not lines:
+            return 0.0
+        comment_time = max(times[line - 1] for line in lines)
+        days = (max(code) - comment_time) / SECONDS_PER_DAY
+        return self.staleness_weight * min(1.0, max(0.0, days) / 365)
+
+
+def prioritize(
+    results: Iterable[dict[str, Any]],
+    scorer: RiskScorer,
+    window: int = DEFAULT_PRIORITY_WINDOW,
+) -> Iterator[dict[str, Any]]:
+    """
+    按风险分数从高到低重新排列所有注释
+
+    需要先取得全部提取结果才能排序，之后按每 window 条一组产出：组内同一文件
+    的注释合并为一个提取结果（保留原文件的作用域表），分析器仍可批量提交。
+    同分的注释保持原有的遍历顺序。每条注释记录其分数 risk。
+
+    排序的只是 (分数, 序号, 文件序号, 注释序号) 元组，注释记录在产出时才按序号
+    查找；提取结果只记录作用域的行区间，一个文件的注释全部产出后即释放其结果。
+
+    Yields:
+        只包含部分注释的单文件提取结果
+    """
+    ranked: list[tuple[float, int, int, int]] = []
+    files: list[Optional[dict[str, Any]]] = []
+    remaining: list[int] = []
+    for file_result in results:
+        comments = file_result.get("comments", [])
+        if not comments:
+            continue
+        file_no = len(files)
+        for comment_no, comment in enumerate(comments):
+            risk = scorer.score(file_result, comment)
+            ranked.append((-risk, len(ranked), file_no, comment_no))
+        scorer.release(file_result["file"])
+        files.append(file_result)
+        remaining.append(len(comments))
+    ranked.sort()
+    logger.info(f"Prioritized {len(ranked)} comments by risk score")
+
+    for offset in range(0, len(ranked), window):
+        groups: dict[int, list[dict[str, Any]]] = {}
+        for negative, _, file_no, comment_no in ranked[offset : offset + window]:
+            comment = files[file_no]["comments"][comment_no]
+            groups.setdefault(file_no, []).append({**comment, "risk": -negative})
+        for file_no, comments in groups.items():
+            file_result = files[file_no]
+            remaining[file_no] -= len(comments)
+            if not remaining[file_no]:
+                files[file_no] = None
+            yield {**file_result, "comments": comments, "total_comments": len(comments)}
+
+
+class Budget:
+    """
+    一次运行的分析预算：请求数、token 数与截止时间
+
+    每个批次提交前检查一次（级联分析的升级请求逐个检查），耗尽后不再提交新请求，
+    已在途的请求正常完成，因此 token 与时间最多超出 max_concurrency 个请求的用量。
+    未分析的注释不写入检查点，可用 --resume 在下一次运行中继续。
+    watch 模式下每轮分析前调用 reset，预算作用于单轮。
+    """
+
+    def __init__(
+        self,
+        usages: Sequence[TokenUsage],
+        max_requests: Optional[int] = None,
+        max_tokens: Optional[int] = None,
+        deadline: Optional[float] = None,
+    ):
+        """
+        Args:
+            usages: 各 LLM 客户端的累计 token 用量（级联分析时有多个）
+            max_requests: 最多提交的请求数
+            max_tokens: 输入与输出 token 总数上限
+            deadline: 从开始运行起的秒数，超过后不再提交请求
+        """
+        self.usages = list(usages)
+        self.max_requests = max_requests
+        self.max_tokens = max_tokens
+        self.deadline = deadline
+        self.requests = 0
+        self.started = time.monotonic()
+        self.reason: Optional[str] = None
+        # 计入预算的 token 从该基线算起
+        self.baseline = 0
+
+    def start(self) -> None:
+        self.started = time.monotonic()
+
+    def reset(self) -> None:
+        """重新开始计数：请求数、token 与截止时间都从现在算起"""
+        self.start()
+        self.requests = 0
+        self.reason = None
+        self.baseline = self._tokens()
+
+    def _tokens(self) -> int:
+        return sum(u.input_tokens + u.output_tokens for u in self.usages)
+
+    def exhausted(self) -> Optional[str]:
+        """预算已耗尽时返回原因，否则返回 None"""
+        if self.max_requests is not None and self.requests >= self.max_requests:
+            return f"{self.requests} requests"
+        tokens = self._tokens() - self.baseline
+        if self.max_tokens is not None and tokens >= self.max_tokens:
+            return f"{tokens} tokens"
+        elapsed = time.monotonic() - self.started
+        if self.deadline is not None and elapsed >= self.deadline:
+            return f"deadline of {self.deadline:g}s"
+        return None
+
+    def admit(self, comments: int) -> bool:
+        """
+        申请提交一个包含 comments 条注释的请求
+
+        Returns:
+            预算未耗尽时记一次请求并返回 True
+        """
+        reason = self.exhausted()
+        if reason is None:
+            self.requests += 1
+            return True
+        if self.reason is None:
+            self.reason = reason
+            logger.warning(f"Analysis budget exhausted ({reason}), skipping the rest")
+        METRICS.counter(
+            "comments_over_budget", "Comments left unanalyzed by the budget"
+        ).inc(comments)
+        return False
+
+    def log_stats(self) -> None:
+        skipped = METRICS.counter("comments_over_budget").value
+        if self.reason is not None:
+            logger.info(
+                f"Budget stopped after {self.reason}; {skipped} comments left "
+                "unanalyzed, rerun with --resume to continue"
+            )
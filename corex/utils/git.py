@@ -0,0 +1,128 @@
+import re
+import subprocess
+from pathlib import Path
+from typing import Any
+
+# @@ -a,b +c,d @@ 中新文件一侧的起始行与行数（行数缺省为 1）
+HUNK_HEADER = re.compile(r"^@@ -\d+(?:,\d+)? \+(\d+)(?:,(\d+))? @@")
+
+
+def _git(cwd: Path, *args: str) -> str:
+    result = subprocess.run(
+        ["git", *args],
+        cwd=cwd,
+        capture_output=True,
+        encoding="utf-8",
+        errors="replace",
+        check=False,
+    )
+    if result.returncode != 0:
+        raise RuntimeError(f"git {' '.join(args)} failed: {result.stderr.strip()}")
+    return result.stdout
+
+
+def _unquote(path: str) -> str:
+    """
+    还原 git 输出中带引号的路径
+
+    core.quotepath=off 时非 ASCII 字符原样输出，但含引号、反斜杠、控制字符的
+    路径仍会被加上 C 风格的引号与转义（字节以八进制表示）
+    """
+    if len(path) < 2 or path[0] != '"' or path[-1] != '"':
+        return path
+    escaped = path[1:-1].encode("utf-8").decode("unicode_escape")
+    return escaped.encode("latin-1").decode("utf-8", errors="replace")
+
+
+def changed_hunks(path: Path, rev: str) -> dict[Path, list[tuple[int, int]]]:
+    """
+    获取相对 rev 发生变化的文件及其新增/修改的行区间
+
+    Args:
+        path: 仓库内的文件或目录，只统计该路径下的变化
+        rev: 比较基准，如 origin/main、HEAD~1
+
+    Returns:
+        文件绝对路径到 [(start_line, end_line), ...] 的映射，行号从 1 开始
+    """
+    path = Path(path).resolve()
+    cwd = path if path.is_dir() else path.parent
+    top = Path(_git(cwd, "rev-parse", "--show-toplevel").strip())
+    # 显式指定前缀与路径输出方式，不受 diff.noprefix / diff.mnemonicPrefix /
+    # core.quotepath 等用户配置影响
+    diff = _git(
+        top,
+        "-c",
+        "core.quotepath=off",
+        "diff",
+        "--src-prefix=a/",
+        "--dst-prefix=b/",
+        "--unified=0",
+        "--no-color",
+        "--no-ext-diff",
+        "--diff-filter=AMR",
+        rev,
+        "--",
+        str(path),
+    )
+
+    hunks: dict[Path, list[tuple[int, int]]] = {}
+    current = None
+    for line in diff.splitlines():
+        if line.startswith("+++ "):
+            target = _unquote(line[4:])
+            current = None if target == "/dev/null" else top / target[2:]
+            if current is not None:
+                hunks.setdefault(current, [])
+            continue
+        match = HUNK_HEADER.match(line)
+        if match and current is not None:
+            start = int(match.group(1))
+            count = int(match.group(2)) if match.group(2) is not None else 1
+            # 纯删除的 hunk 在新文件中没有行
+            if count > 0:
+                hunks[current].append((start, start + count - 1))
+    return hunks
+
+
+def filter_changed_comments(
+    file_result: dict[str, Any], ranges: list[tuple[int, int]]
+) -> dict[str, Any]:
+    """
+    只保留行区间与变更 hunk 相交的注释
+
+    Args:
+        file_result: 单个文件的提取结果
+        ranges: 该文件的变更行区间
+
+    Returns:
+        过滤后的提取结果
+    """
+    comments = [
+        comment
+        for comment in file_result.get("comments", [])
+        if any(
+            comment["start_line"] <= end and start <= comment["end_line"]
+            for start, end in ranges
+        )
+    ]
+    return {**file_result, "total_comments": len(comments), "comments": comments}
+
+
+def blame_times(path: Path) -> list[int]:
+    """
+    git blame 得到的每行最后修改时间
+
+    Args:
+        path: 仓库内的文件
+
+    Returns:
+        第 i 个元素为第 i + 1 行的 author-time（Unix 秒）；未提交的行为当前时间
+    """
+    path = Path(path).resolve()
+    output = _git(path.parent, "blame", "--line-porcelain", "--", path.name)
+    return [
+        int(line.split(" ", 1)[1])
+        for line in output.splitlines()
+        if line.startswith("author-time ")
+    ]
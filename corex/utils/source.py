@@ -0,0 +1,123 @@
+import bisect
+import codecs
+import hashlib
+import mmap
+import re
+from functools import cached_property
+from pathlib import Path
+from typing import Optional, Sequence
+
+# 不小于该大小的文件使用 mmap 读取，更小的文件直接读入内存（mmap 的系统调用开销更大）
+MMAP_THRESHOLD = 1 << 16
+# 逐段解码时依次尝试的编码；latin-1 能解码任意字节，保证不会失败
+FALLBACK_ENCODINGS = ("utf-8", "gbk", "cp1252", "latin-1")
+# 需要先转成 UTF-8 才能交给 tree-sitter 的编码，按 BOM 识别（长的 BOM 优先）
+_TRANSCODE_BOMS = (
+    (codecs.BOM_UTF32_LE, "utf-32"),
+    (codecs.BOM_UTF32_BE, "utf-32"),
+    (codecs.BOM_UTF16_LE, "utf-16"),
+    (codecs.BOM_UTF16_BE, "utf-16"),
+)
+
+
+class SourceFile:
+    """
+    只读的源文件缓冲区
+
+    大文件通过 mmap 映射，缓冲区直接交给 tree-sitter 解析，不再复制整个文件，
+    也不预先解码与按行切分：文本按字节区间解码，行号与行文本通过首次使用时
+    建立的行首偏移表得到。
+
+    解码按 FALLBACK_ENCODINGS 逐段回退，一个文件中混有 UTF-8 与 GBK/cp1252
+    也能正常读取；UTF-16/32（带 BOM）的文件在打开时转为 UTF-8。
+    """
+
+    def __init__(self, path: Path, encodings: Sequence[str] = FALLBACK_ENCODINGS):
+        """
+        Args:
+            path: 文件路径
+            encodings: 解码回退顺序
+        """
+        self.path = Path(path)
+        self.encodings = tuple(encodings)
+        self._mmap: Optional[mmap.mmap] = None
+        with open(self.path, "rb") as f:
+            size = self.path.stat().st_size
+            if size >= MMAP_THRESHOLD:
+                self._mmap = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+                self.data: bytes | mmap.mmap = self._mmap
+            else:
+                self.data = f.read()
+
+        head = self.data[:4]
+        for bom, encoding in _TRANSCODE_BOMS:
+            if head.startswith(bom):
+                text = bytes(self.data).decode(encoding, errors="replace")
+                self.close()
+                self.data = text.encode("utf-8")
+                break
+
+    def __len__(self) -> int:
+        return len(self.data)
+
+    def __enter__(self) -> "SourceFile":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def close(self) -> None:
+        if self._mmap is not None:
+            self._mmap.close()
+            self._mmap = None
+        self.data = b""
+
+    def decode(self, start: int = 0, end: Optional[int] = None) -> str:
+        """
+        解码 [start, end) 字节区间，依次尝试各编码
+
+        Returns:
+            解码后的文本，UTF-8 BOM 会被去掉
+        """
+        chunk = self.data[start:end]
+        if start == 0 and chunk.startswith(codecs.BOM_UTF8):
+            chunk = chunk[len(codecs.BOM_UTF8) :]
+        for encoding in self.encodings[:-1]:
+            try:
+                return chunk.decode(encoding)
+            except UnicodeDecodeError:
+                continue
+        return chunk.decode(self.encodings[-1], errors="replace")
+
+    def digest(self) -> str:
+        """内容哈希，用于判断文件内容是否变化"""
+        return hashlib.blake2b(self.data, digest_size=16).hexdigest()
+
+    @cached_property
+    def line_starts(self) -> list[int]:
+        """每行首字节的偏移，首次访问时扫描一次换行符"""
+        return [0] + [m.end() for m in re.finditer(b"\n", self.data)]
+
+    def line_of(self, offset: int) -> int:
+        """字节偏移所在的行（从 0 开始）"""
+        return bisect.bisect_right(self.line_starts, offset) - 1
+
+    def line_range(self, start_line: int, end_line: int) -> tuple[int, int]:
+        """
+        第 start_line 到 end_line 行（从 1 开始，含两端）的字节区间，不含末尾换行
+        """
+        starts = self.line_starts
+        start_line = max(1, start_line)
+        if start_line - 1 < len(starts):
+            start = starts[start_line - 1]
+        else:
+            start = len(self.data)
+        if end_line < len(starts):
+            end = starts[end_line] - 1
+        else:
+            end = len(self.data)
+        return start, max(start, end)
+
+    def lines(self, start_line: int, end_line: int) -> str:
+        """第 start_line 到 end_line 行的文本（从 1 开始，含两端）"""
+        return self.decode(*self.line_range(start_line, end_line))
@@ -0,0 +1,35 @@
+import re
+
+# 行首的注释标记：//、///、//!、#、/*、/**、*
+_LINE_MARKER = re.compile(r"^\s*(?:/\*+!?|\*+/|//+[!/]?|#+|\*+(?!/))\s?")
+_BLOCK_END = re.compile(r"\s*\*+/\s*$")
+_DOCSTRING_QUOTES = re.compile(r"^[rRbBuUfF]*(\"\"\"|'''|\"|')(.*)\1$", re.DOTALL)
+
+
+def strip_comment_markers(text: str) -> str:
+    """
+    去掉注释标记与 docstring 引号，只保留注释正文
+
+    Args:
+        text: 原始注释文本
+
+    Returns:
+        注释正文，保留原有换行
+    """
+    match = _DOCSTRING_QUOTES.match(text.strip())
+    if match:
+        return match.group(2).strip()
+    lines = []
+    for line in text.split("\n"):
+        line = _BLOCK_END.sub("", line)
+        lines.append(_LINE_MARKER.sub("", line, count=1).rstrip())
+    return "\n".join(lines).strip()
+
+
+def normalize_comment(text: str) -> str:
+    """
+    归一化注释用于去重：去掉注释标记，并把空白（含换行）压缩为单个空格
+
+    大小写与标点保持不变，以免掩盖大小写类的拼写问题。
+    """
+    return " ".join(strip_comment_markers(text).split())
@@ -0,0 +1,44 @@
+from functools import lru_cache
+
+from loguru import logger
+
+try:
+    import tiktoken
+except ImportError:  # pragma: no cover - tiktoken 随 langchain-openai 一起安装
+    tiktoken = None
+
+
+class TokenCounter:
+    """
+    按模型统计 token 数
+
+    优先使用模型对应的 tiktoken 编码；未收录的模型（如 deepseek-chat）
+    使用 cl100k_base 近似，tiktoken 不可用时退化为按字符数估算。
+    """
+
+    def __init__(self, model_name: str = ""):
+        self.model_name = model_name
+        self.encoding = _load_encoding(model_name)
+
+    def count(self, text: str) -> int:
+        if not text:
+            return 0
+        if self.encoding is None:
+            return len(text) // 4 + 1
+        return len(self.encoding.encode(text, disallowed_special=()))
+
+
+@lru_cache(maxsize=None)
+def _load_encoding(model_name: str):
+    if tiktoken is None:
+        logger.warning("tiktoken is not installed, estimating tokens by length")
+        return None
+    try:
+        try:
+            return tiktoken.encoding_for_model(model_name)
+        except KeyError:
+            return tiktoken.get_encoding("cl100k_base")
+    except Exception as e:
+        # 编码文件需要联网下载，离线环境下退化为估算
+        logger.warning(f"Failed to load tokenizer for {model_name}: {e!s}")
+        return None
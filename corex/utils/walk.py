@@ -0,0 +1,367 @@
+import hashlib
+import os
+import re
+import time
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Iterator, Optional, Sequence
+
+from loguru import logger
+
+from ..config import (
+    DEFAULT_EXCLUDE_DIRS,
+    DEFAULT_MAX_FILE_SIZE,
+    DEFAULT_ROOT_EXCLUDE_DIRS,
+    IGNORE_FILES,
+)
+from ..metrics import METRICS
+
+# 生成文件的标记，只在文件开头 GENERATED_HEAD_BYTES 字节内查找；单独的 "do not edit"
+# 常见于手写代码的注释，要求同一行内同时出现 generated（如 Go 的
+# "Code generated ... DO NOT EDIT." 与 protoc 的 "Generated by ... DO NOT EDIT!"）
+_GENERATED_MARKERS = re.compile(
+    rb"@generated|generated\b[^\n]{0,80}?\bdo not edit\b"
+    rb"|\bdo not edit\b[^\n]{0,80}?generated|auto-?generated (?:file|code)"
+    rb"|this file (?:is|was|has been) (?:automatically |auto-)?generated",
+    re.IGNORECASE,
+)
+GENERATED_HEAD_BYTES = 2048
+# 目录 mtime 与列出时间相差不到该值（纳秒）时不复用列表：粗粒度时间戳的文件系统上，
+# 列出之后同一时间片内的修改不会改变 mtime
+RACY_LISTING_NS = 1_000_000_000
+
+
+@dataclass
+class IgnoreRule:
+    """一条 gitignore 风格的规则，base 为规则文件所在目录（相对扫描根目录）"""
+
+    regex: re.Pattern[str]
+    base: str = ""
+    negate: bool = False
+    dir_only: bool = False
+
+    def match(self, rel_path: str, is_dir: bool) -> bool:
+        if self.dir_only and not is_dir:
+            return False
+        if self.base:
+            if not rel_path.startswith(self.base + "/"):
+                return False
+            rel_path = rel_path[len(self.base) + 1 :]
+        return self.regex.fullmatch(rel_path) is not None
+
+
+def compile_pattern(pattern: str, base: str = "") -> Optional[IgnoreRule]:
+    """
+    将 gitignore 风格的模式编译为规则
+
+    支持 `!` 取反、末尾 `/` 只匹配目录、`*` / `?` / `[...]` / `**`；
+    不含 `/` 的模式匹配任意层级的文件名，含 `/` 的模式相对 base 匹配。
+
+    Args:
+        pattern: 模式文本
+        base: 模式所在目录（相对扫描根目录），命令行模式为空
+
+    Returns:
+        规则，空行与注释行返回 None
+    """
+    pattern = pattern.rstrip("\n").rstrip()
+    if not pattern or pattern.startswith("#"):
+        return None
+    negate = pattern.startswith("!")
+    if negate:
+        pattern = pattern[1:]
+    if pattern.startswith("\\"):
+        pattern = pattern[1:]
+    dir_only = pattern.endswith("/")
+    pattern = pattern.rstrip("/")
+    if not pattern:
+        return None
+    anchored = "/" in pattern
+    pattern = pattern.lstrip("/")
+
+    regex, i = "", 0
+    while i < len(pattern):
+        if pattern.startswith("**/", i):
+            regex += "(?:.*/)?"
+            i += 3
+        elif pattern.startswith("/**", i) and i + 3 == len(pattern):
+            regex += "/.*"
+            i += 3
+        elif pattern.startswith("**", i):
+            regex += ".*"
+            i += 2
+        elif pattern[i] == "*":
+            regex += "[^/]*"
+            i += 1
+        elif pattern[i] == "?":
+            regex += "[^/]"
+            i += 1
+        elif pattern[i] == "[" and "]" in pattern[i + 1 :]:
+            end = pattern.index("]", i + 1)
+            body = pattern[i + 1 : end].replace("\\", "\\\\")
+            if body.startswith("!"):
+                body = "^" + body[1:]
+            regex += f"[{body}]"
+            i = end + 1
+        else:
+            regex += re.escape(pattern[i])
+            i += 1
+    if not anchored:
+        regex = "(?:.*/)?" + regex
+    return IgnoreRule(re.compile(regex), base, negate, dir_only)
+
+
+def load_ignore_file(path: Path, base: str) -> list[IgnoreRule]:
+    try:
+        with open(path, "r", encoding="utf-8", errors="replace") as f:
+            lines = f.readlines()
+    except OSError as e:
+        logger.warning(f"Cannot read ignore file {path}: {e!s}")
+        return []
+    return [rule for line in lines if (rule := compile_pattern(line, base))]
+
+
+def is_generated(path: Path) -> bool:
+    """文件开头是否带有生成文件标记（DO NOT EDIT、@generated 等）"""
+    try:
+        with open(path, "rb") as f:
+            head = f.read(GENERATED_HEAD_BYTES)
+    except OSError:
+        return False
+    return _GENERATED_MARKERS.search(head) is not None
+
+
+def shard_of(rel_path: str, count: int) -> int:
+    """
+    文件所属的分片（从 0 开始），按相对扫描根目录的路径哈希
+
+    不依赖检出目录与机器，各节点对同一仓库的划分一致，同一文件总落在同一分片，
+    分片各自的提取索引与缓存在多次运行之间保持有效。
+    """
+    digest = hashlib.blake2b(rel_path.encode("utf-8"), digest_size=8).digest()
+    return int.from_bytes(digest, "big") % count
+
+
+@dataclass
+class PathFilter:
+    """
+    目录扫描的过滤条件
+
+    Attributes:
+        include: 文件需匹配其中之一的模式（为空表示不限制）
+        exclude: 排除的文件/目录模式，语法同 .gitignore
+        exclude_dirs: 在任意层级按名称直接剪枝的目录
+        root_exclude_dirs: 只在扫描根目录下按名称剪枝的目录
+        ignore_files: 各层目录中读取的忽略文件（.gitignore / .corexignore）
+        max_file_size: 文件大小上限（字节），0 表示不限制
+        skip_generated: 是否跳过带有生成文件标记的文件
+        shard: (分片序号, 分片总数)，序号从 0 开始，只保留属于该分片的文件
+    """
+
+    include: Sequence[str] = ()
+    exclude: Sequence[str] = ()
+    exclude_dirs: Sequence[str] = DEFAULT_EXCLUDE_DIRS
+    root_exclude_dirs: Sequence[str] = DEFAULT_ROOT_EXCLUDE_DIRS
+    ignore_files: Sequence[str] = IGNORE_FILES
+    max_file_size: int = DEFAULT_MAX_FILE_SIZE
+    skip_generated: bool = True
+    shard: Optional[tuple[int, int]] = None
+    _include: list[IgnoreRule] = field(init=False, repr=False)
+    _exclude: list[IgnoreRule] = field(init=False, repr=False)
+
+    def __post_init__(self):
+        self._include = [r for p in self.include if (r := compile_pattern(p))]
+        self._exclude = [r for p in self.exclude if (r := compile_pattern(p))]
+        self.exclude_dirs = frozenset(self.exclude_dirs)
+        self.root_exclude_dirs = frozenset(self.root_exclude_dirs)
+
+    def excluded(self, rel_path: str, is_dir: bool, rules: list[IgnoreRule]) -> bool:
+        if any(rule.match(rel_path, is_dir) for rule in self._exclude):
+            return True
+        # gitignore 语义：最后一条匹配的规则生效
+        ignored = False
+        for rule in rules:
+            if rule.match(rel_path, is_dir):
+                ignored = not rule.negate
+        return ignored
+
+    def included(self, rel_path: str) -> bool:
+        return not self._include or any(
+            rule.match(rel_path, False) for rule in self._include
+        )
+
+    def in_shard(self, rel_path: str) -> bool:
+        if self.shard is None:
+            return True
+        index, count = self.shard
+        return shard_of(rel_path, count) == index
+
+
+@dataclass
+class WalkCache:
+    """
+    多次遍历之间复用的目录列表与文件判定（watch 模式每轮轮询都遍历一次）
+
+    目录的 mtime 未变化时复用上次列出的条目，文件的增删与改名都会改变所在目录的
+    mtime；忽略文件按 mtime 缓存解析结果；生成文件判定按文件的 (mtime, size)
+    缓存，内容未变化时不再读取文件头。
+
+    Attributes:
+        listings: 目录 -> (mtime_ns, 列出时间, [(名称, 是否目录, 是否文件)])
+        rules: 忽略文件 -> (mtime_ns, 规则)
+        generated: 文件 -> (mtime_ns, size, 是否为生成文件)
+        stats: 最近一次遍历产出的文件 -> (mtime_ns, size)
+    """
+
+    listings: dict[str, tuple[int, int, list[tuple[str, bool, bool]]]] = field(
+        default_factory=dict
+    )
+    rules: dict[str, tuple[int, list[IgnoreRule]]] = field(default_factory=dict)
+    generated: dict[str, tuple[int, int, bool]] = field(default_factory=dict)
+    stats: dict[str, tuple[int, int]] = field(default_factory=dict)
+
+
+def _list_dir(
+    directory: str, cache: Optional[WalkCache]
+) -> list[tuple[str, bool, bool]]:
+    """按名称排序列出目录条目 (名称, 是否目录, 是否文件)；目录不可读时抛出 OSError"""
+    mtime = 0
+    if cache is not None:
+        mtime = os.stat(directory).st_mtime_ns
+        cached = cache.listings.get(directory)
+        if cached is not None and cached[0] == mtime:
+            if cached[1] - mtime >= RACY_LISTING_NS:
+                return cached[2]
+    listed_at = time.time_ns()
+    entries = []
+    with os.scandir(directory) as it:
+        for entry in it:
+            try:
+                entries.append(
+                    (entry.name, entry.is_dir(follow_symlinks=False), entry.is_file())
+                )
+            except OSError as e:
+                logger.warning(f"Cannot stat {entry.path}: {e!s}")
+    entries.sort()
+    if cache is not None:
+        cache.listings[directory] = (mtime, listed_at, entries)
+    return entries
+
+
+def _ignore_rules(path: str, base: str, cache: Optional[WalkCache]) -> list[IgnoreRule]:
+    if cache is None:
+        return load_ignore_file(Path(path), base)
+    try:
+        mtime = os.stat(path).st_mtime_ns
+    except OSError:
+        return load_ignore_file(Path(path), base)
+    cached = cache.rules.get(path)
+    if cached is not None and cached[0] == mtime:
+        return cached[1]
+    rules = load_ignore_file(Path(path), base)
+    cache.rules[path] = (mtime, rules)
+    return rules
+
+
+def _is_generated(
+    path: str, stat: Optional[os.stat_result], cache: Optional[WalkCache]
+) -> bool:
+    if cache is None or stat is None:
+        return is_generated(Path(path))
+    cached = cache.generated.get(path)
+    if cached is not None and cached[:2] == (stat.st_mtime_ns, stat.st_size):
+        return cached[2]
+    generated = is_generated(Path(path))
+    cache.generated[path] = (stat.st_mtime_ns, stat.st_size, generated)
+    return generated
+
+
+def walk_files(
+    root: Path,
+    suffixes: Sequence[str],
+    path_filter: Optional[PathFilter] = None,
+    cache: Optional[WalkCache] = None,
+) -> Iterator[Path]:
+    """
+    基于 os.scandir 的目录遍历，在进入目录前剪枝
+
+    被排除的目录（默认目录、exclude 模式、忽略文件）不会被列出内容；
+    文件依次经过后缀、忽略规则、include、分片、大小上限与生成文件检查，
+    生成文件检查只读取文件开头，放在最后。同层条目按名称排序，结果顺序稳定。
+
+    Args:
+        root: 扫描根目录
+        suffixes: 需要的文件后缀
+        path_filter: 过滤条件，None 时使用默认条件
+        cache: 跨遍历复用的目录列表与文件判定，None 表示每次完整遍历
+
+    Yields:
+        通过过滤的文件路径
+    """
+    path_filter = path_filter or PathFilter()
+    suffixes = tuple(suffixes)
+    skipped = {
+        reason: METRICS.counter(f"files_skipped_{reason}", f"Files skipped: {reason}")
+        for reason in ("ignored", "shard", "size", "generated")
+    }
+
+    stack: list[tuple[str, str, list[IgnoreRule]]] = [(str(root), "", [])]
+    while stack:
+        directory, rel_dir, rules = stack.pop()
+        try:
+            entries = _list_dir(directory, cache)
+        except OSError as e:
+            logger.warning(f"Cannot list {directory}: {e!s}")
+            continue
+
+        names = {name for name, _, _ in entries}
+        local = [
+            rule
+            for name in path_filter.ignore_files
+            if name in names
+            for rule in _ignore_rules(os.path.join(directory, name), rel_dir, cache)
+        ]
+        if local:
+            rules = rules + local
+
+        subdirs = []
+        for name, is_dir, is_file in entries:
+            path = os.path.join(directory, name)
+            rel_path = f"{rel_dir}/{name}" if rel_dir else name
+            if is_dir:
+                pruned = name in path_filter.exclude_dirs
+                if not rel_dir and name in path_filter.root_exclude_dirs:
+                    logger.debug(f"Skipping {path}: excluded by default at the root")
+                    pruned = True
+                if not pruned and not path_filter.excluded(rel_path, True, rules):
+                    subdirs.append((path, rel_path, rules))
+                continue
+            if not is_file or not name.endswith(suffixes):
+                continue
+            excluded = path_filter.excluded(rel_path, False, rules)
+            if excluded or not path_filter.included(rel_path):
+                skipped["ignored"].inc()
+                continue
+            if not path_filter.in_shard(rel_path):
+                skipped["shard"].inc()
+                continue
+            stat = None
+            if path_filter.max_file_size or cache is not None:
+                try:
+                    stat = os.stat(path)
+                except OSError as e:
+                    logger.warning(f"Cannot stat {path}: {e!s}")
+                    continue
+            if path_filter.max_file_size and stat.st_size > path_filter.max_file_size:
+                logger.debug(f"Skipping {path}: larger than size cap")
+                skipped["size"].inc()
+                continue
+            if path_filter.skip_generated and _is_generated(path, stat, cache):
+                logger.debug(f"Skipping generated file {path}")
+                skipped["generated"].inc()
+                continue
+            if cache is not None:
+                cache.stats[path] = (stat.st_mtime_ns, stat.st_size)
+            yield Path(path)
+        # 逆序入栈，按名称顺序深度优先
+        stack.extend(reversed(subdirs))
@@ -0,0 +1,130 @@
+import json
+import re
+from typing import Any, Optional
+
+# 注释结论的类型；AnalyzerWithContext 另在 "code" 字段给出代码结论
+VERDICT_TYPES = ("Normal", "Typo", "Grammar", "Legacy", "Inconsistent")
+CODE_VERDICT_TYPES = ("Normal", "Bug", "Inefficient", "BadPractice")
+# 模型偶尔使用的同义写法，按小写匹配
+_ALIASES = {
+    "none": "Normal",
+    "ok": "Normal",
+    "no issue": "Normal",
+    "no issues": "Normal",
+    "spelling": "Typo",
+    "typos": "Typo",
+    "legacy information": "Legacy",
+    "outdated": "Legacy",
+    "inconsistency": "Inconsistent",
+    "optimization": "Inefficient",
+    "inefficiency": "Inefficient",
+    "bad practice": "BadPractice",
+}
+_CANONICAL = {name.lower(): name for name in VERDICT_TYPES + CODE_VERDICT_TYPES}
+_FENCE = re.compile(r"^```(?:json)?\s*|\s*```$", re.MULTILINE)
+_TYPE_FIELD = re.compile(r'"type"\s*:\s*"([^"]*)"')
+_DECODER = json.JSONDecoder()
+
+
+def normalize_type(value: Any) -> str:
+    """将结论类型统一为 VERDICT_TYPES / CODE_VERDICT_TYPES 中的写法"""
+    text = str(value or "Normal").strip()
+    lowered = text.lower()
+    return _CANONICAL.get(lowered) or _ALIASES.get(lowered) or text
+
+
+def normalize_verdict(verdict: dict[str, Any]) -> dict[str, Any]:
+    """统一类型写法，去掉 Normal 结论中无意义的字段"""
+    verdict = {key: value for key, value in verdict.items() if value is not None}
+    verdict["type"] = normalize_type(verdict.get("type"))
+    if verdict["type"] == "Normal":
+        verdict = {
+            key: value
+            for key, value in verdict.items()
+            if key not in ("detail", "origin", "replacement")
+        }
+    code = verdict.get("code")
+    if isinstance(code, dict):
+        code = {key: value for key, value in code.items() if value is not None}
+        code["type"] = normalize_type(code.get("type"))
+        if code["type"] == "Normal":
+            code.pop("detail", None)
+        verdict["code"] = code
+    return verdict
+
+
+def _repair(fragment: str) -> Optional[dict[str, Any]]:
+    """
+    补全被 max_tokens 截断的 JSON 对象：闭合字符串与括号，去掉悬空的逗号与键
+    """
+    stack, in_string, escaped = [], False, False
+    for char in fragment:
+        if in_string:
+            if escaped:
+                escaped = False
+            elif char == "\\":
+                escaped = True
+            elif char == '"':
+                in_string = False
+        elif char == '"':
+            in_string = True
+        elif char in "{[":
+            stack.append("}" if char == "{" else "]")
+        elif char in "}]" and stack:
+            stack.pop()
+    if not stack:
+        return None
+    text = fragment + ('"' if in_string else "")
+    text = text.rstrip().rstrip(",")
+    if text.endswith(":"):
+        text += " null"
+    try:
+        repaired = json.loads(text + "".join(reversed(stack)))
+    except json.JSONDecodeError:
+        return None
+    return repaired if isinstance(repaired, dict) else None
+
+
+def parse_verdict(response: str) -> Optional[dict[str, Any]]:
+    """
+    从 LLM 响应中解析结论，不需要再次请求
+
+    去掉代码块标记后解析第一个含 "type" 的 JSON 对象，被截断的对象先补全再解析；
+    都失败时只提取 "type" 字段。结论会经过 normalize_verdict 统一写法。
+
+    Returns:
+        结论字典，响应中没有任何可识别的结论时返回 None
+    """
+    text = _FENCE.sub("", response.strip())
+    start = text.find("{")
+    while start != -1:
+        try:
+            verdict, _ = _DECODER.raw_decode(text, start)
+        except json.JSONDecodeError:
+            # 先补全外层对象，避免把截断结论中嵌套的 code 对象当成结论
+            verdict = _repair(text[start:])
+        if isinstance(verdict, dict) and "type" in verdict:
+            return normalize_verdict(verdict)
+        start = text.find("{", start + 1)
+    match = _TYPE_FIELD.search(text)
+    if match is not None:
+        return normalize_verdict({"type": match.group(1)})
+    return None
+
+
+def format_verdict(verdict: dict[str, Any]) -> str:
+    """结论的紧凑 JSON 表示，作为缓存与报告中的响应文本"""
+    return json.dumps(verdict, ensure_ascii=False, separators=(",", ":"))
+
+
+def is_finding(verdict: Optional[dict[str, Any]]) -> bool:
+    """
+    结论是否需要写入报告：注释或代码结论不是 Normal
+
+    无法解析的响应保守地视为发现，原始响应会写入报告供人工确认。
+    """
+    if verdict is None:
+        return True
+    code = verdict.get("code")
+    code_type = code.get("type", "Normal") if isinstance(code, dict) else "Normal"
+    return verdict.get("type") != "Normal" or code_type != "Normal"
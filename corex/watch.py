@@ -0,0 +1,51 @@
+import os
+from pathlib import Path
+
+from loguru import logger
+
+from .extractor import Extractor
+from .utils.walk import WalkCache
+
+
+class FileWatcher:
+    """
+    轮询扫描范围内文件的 (mtime, size)，得到两次轮询之间的变化
+
+    不依赖文件系统事件，编辑器的原子保存（写临时文件再改名）与网络文件系统
+    都能正常识别；目录遍历沿用提取器的过滤条件，被忽略的目录不会被列出。
+    轮询之间复用 WalkCache：只有 mtime 变化的目录会被重新列出，未变化的文件
+    不会重新读取文件头做生成文件判定，每轮的开销主要是对已知文件的 stat。
+    """
+
+    def __init__(self, extractor: Extractor, file_path: Path):
+        self.extractor = extractor
+        self.file_path = Path(file_path)
+        self.snapshot: dict[Path, tuple[int, int]] = {}
+        self.walk_cache = WalkCache()
+
+    def poll(self) -> tuple[list[Path], list[Path]]:
+        """
+        重新扫描一次
+
+        Returns:
+            (新增或修改的文件, 被删除的文件)；首次调用时所有文件都算作新增
+        """
+        current: dict[Path, tuple[int, int]] = {}
+        self.walk_cache.stats.clear()
+        for file in self.extractor.collect_files(self.file_path, self.walk_cache):
+            # 遍历时已经 stat 过的文件直接使用其结果，单文件目标等情况再 stat 一次
+            key = self.walk_cache.stats.get(str(file))
+            if key is None:
+                try:
+                    stat = os.stat(file)
+                except OSError:
+                    # 遍历之后被删除，或正在被编辑器替换
+                    continue
+                key = (stat.st_mtime_ns, stat.st_size)
+            current[file] = key
+        changed = [f for f, key in current.items() if self.snapshot.get(f) != key]
+        removed = [f for f in self.snapshot if f not in current]
+        self.snapshot = current
+        if changed or removed:
+            logger.debug(f"Watch: {len(changed)} changed, {len(removed)} removed")
+        return changed, removed
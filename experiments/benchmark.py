@@ -0,0 +1,605 @@
+"""
+CoRex 性能基准：注释提取吞吐与端到端扫描吞吐
+
+- extract：测量 CommentExtractor 的 files/s、MB/s、comments/s 与内存峰值
+- e2e：在本地启动模拟 OpenAI 接口的 HTTP 服务（延迟可配置），测量完整扫描的吞吐；
+  --backend inprocess 时改用 corex.llms 的进程内 mock provider，排除 HTTP 开销
+
+语料可以是按语言生成的合成语料，也可以用 --corpus 指定真实代码目录。
+每次结果追加到 history 文件（JSONL），并与相同配置的历史结果比较，
+吞吐下降超过容忍度时报告性能回退。
+
+python -m experiments.benchmark extract --language cpp --files 500
+python -m experiments.benchmark e2e --language python --latency 0.2 --max-concurrency 32
+"""
+
+import json
+import random
+import resource
+import statistics
+import subprocess
+import tempfile
+import threading
+import time
+import tracemalloc
+from contextlib import nullcontext
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+from typing import Any, Optional
+
+import typer
+import yaml
+from loguru import logger
+
+from corex.analyzer import AnalyzerWithoutContext
+from corex.config import LANGUAGE_SUFFIX_MAP, ROOT_DIR
+from corex.extractor import CommentExtractor
+from corex.llms import LLM, mock_content
+from corex.main import CoRex
+from corex.metrics import METRICS
+from corex.prefilter import PreFilter
+from corex.report import ReportSink
+
+HISTORY_PATH = ROOT_DIR / "experiments" / "benchmark_history.jsonl"
+# 参与回退判断的指标，均为越大越好
+THROUGHPUT_KEYS = ("files_per_second", "mb_per_second", "comments_per_second")
+
+app = typer.Typer(add_completion=False)
+
+# ---------------------------------------------------------------------------
+# 合成语料
+# ---------------------------------------------------------------------------
+
+_WORDS = (
+    "buffer index offset tensor kernel stride device stream cache handle value "
+    "result shape batch thread block queue config option parser token layout"
+).split()
+
+
+def _transpose(word: str) -> str:
+    """交换中间两个字母制造拼写错误（源码中不出现错误拼写，避免触发 typos 检查）"""
+    i = len(word) // 2 - 1
+    return word[:i] + word[i + 1] + word[i] + word[i + 2 :]
+
+
+# 正确拼写 -> 植入合成语料的错误拼写
+_TYPOS = {w: _transpose(w) for w in ("receive", "occurred", "separate", "length")}
+
+
+def _sentence(rng: random.Random) -> str:
+    words = rng.sample(_WORDS, rng.randint(4, 9))
+    if rng.random() < 0.1:
+        words.append(rng.choice(list(_TYPOS.values())))
+    return " ".join(words).capitalize()
+
+
+def _python_unit(rng: random.Random, i: int) -> str:
+    return (
+        f"class Worker{i}:\n"
+        f'    """{_sentence(rng)}."""\n\n'
+        f"    def run_{i}(self, value, offset=0):\n"
+        f'        """{_sentence(rng)}."""\n'
+        f"        # {_sentence(rng)}\n"
+        f"        total = value + offset  # {_sentence(rng)}\n"
+        f"        for step in range({i % 7 + 1}):\n"
+        f"            # {_sentence(rng)}\n"
+        f"            total += step\n"
+        f"        return total\n\n"
+    )
+
+
+def _cpp_unit(rng: random.Random, i: int) -> str:
+    return (
+        f"/**\n * @brief {_sentence(rng)}\n * @param value {_sentence(rng)}\n */\n"
+        f"int compute_{i}(int value, const int* data) {{\n"
+        f"    // {_sentence(rng)}\n"
+        f"    int total = value;  // {_sentence(rng)}\n"
+        f"    for (int k = 0; k < {i % 7 + 1}; ++k) {{\n"
+        f"        /* {_sentence(rng)} */\n"
+        f"        total += data[k];\n"
+        f"    }}\n"
+        f"    return total;\n}}\n\n"
+        f"struct State{i} {{\n    // {_sentence(rng)}\n    int value;\n}};\n\n"
+    )
+
+
+def _cuda_unit(rng: random.Random, i: int) -> str:
+    return (
+        f"// {_sentence(rng)}\n"
+        f"__global__ void kernel_{i}(float* out, const float* in, int n) {{\n"
+        f"    // {_sentence(rng)}\n"
+        f"    int idx = blockIdx.x * blockDim.x + threadIdx.x;\n"
+        f"    if (idx < n) {{\n"
+        f"        out[idx] = in[idx] * {i % 5 + 1}.0f;  // {_sentence(rng)}\n"
+        f"    }}\n}}\n\n"
+        f"void launch_{i}(float* out, const float* in, int n) {{\n"
+        f"    /* {_sentence(rng)} */\n"
+        f"    kernel_{i}<<<(n + 255) / 256, 256>>>(out, in, n);\n}}\n\n"
+    )
+
+
+def _objc_unit(rng: random.Random, i: int) -> str:
+    return (
+        f"/// {_sentence(rng)}\n"
+        f"@interface Worker{i} : NSObject\n"
+        f"// {_sentence(rng)}\n"
+        f"- (int)run:(int)value;\n@end\n\n"
+        f"@implementation Worker{i}\n"
+        f"- (int)run:(int)value {{\n"
+        f"    // {_sentence(rng)}\n"
+        f"    return value + {i};  /* {_sentence(rng)} */\n}}\n@end\n\n"
+    )
+
+
+SYNTHETIC_UNITS = {
+    "python": _python_unit,
+    "cpp": _cpp_unit,
+    "cuda": _cuda_unit,
+    "objective-c": _objc_unit,
+}
+
+
+def generate_corpus(
+    language: str, out_dir: Path, files: int, units: int, seed: int = 0
+) -> Path:
+    """
+    生成确定性的合成语料
+
+    Args:
+        language: 语言，需在 SYNTHETIC_UNITS 中
+        out_dir: 输出目录
+        files: 文件数
+        units: 每个文件包含的代码单元（带注释的函数/类）数
+        seed: 随机种子，相同参数生成完全相同的语料
+
+    Returns:
+        语料目录
+    """
+    if language not in SYNTHETIC_UNITS:
+        raise ValueError(f"No synthetic corpus for language: {language}")
+    unit = SYNTHETIC_UNITS[language]
+    suffix = LANGUAGE_SUFFIX_MAP[language][0]
+    rng = random.Random(seed)
+    out_dir.mkdir(parents=True, exist_ok=True)
+    for f in range(files):
+        # 分散到子目录，接近真实仓库的目录结构
+        path = out_dir / f"pkg{f % 16}" / f"file_{f}{suffix}"
+        path.parent.mkdir(parents=True, exist_ok=True)
+        path.write_text(
+            "".join(unit(rng, f * units + u) for u in range(units)), encoding="utf-8"
+        )
+    return out_dir
+
+
+# ---------------------------------------------------------------------------
+# 模拟 LLM 服务
+# ---------------------------------------------------------------------------
+
+
+class MockLLMServer:
+    """
+    兼容 OpenAI /v1/chat/completions 的本地模拟服务
+
+    每个请求按正态分布 N(latency, jitter) 休眠后返回固定结论：
+    注释中含合成语料植入的拼写错误时返回 Typo，否则返回 Normal；
+    批量请求（## Case<i>）返回 {"cases": [...]}。
+    """
+
+    def __init__(self, latency: float = 0.0, jitter: float = 0.0):
+        self.latency = latency
+        self.jitter = jitter
+        self.requests = 0
+        self._lock = threading.Lock()
+        server = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_POST(self):
+                length = int(self.headers.get("Content-Length", 0))
+                body = json.loads(self.rfile.read(length) or b"{}")
+                payload = json.dumps(server.complete(body)).encode("utf-8")
+                self.send_response(200)
+                self.send_header("Content-Type", "application/json")
+                self.send_header("Content-Length", str(len(payload)))
+                self.end_headers()
+                self.wfile.write(payload)
+
+            def log_message(self, format, *args):
+                pass
+
+        self.httpd = ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+        self.httpd.daemon_threads = True
+        self.thread = threading.Thread(target=self.httpd.serve_forever, daemon=True)
+
+    @property
+    def base_url(self) -> str:
+        host, port = self.httpd.server_address[:2]
+        return f"http://{host}:{port}/v1"
+
+    def complete(self, body: dict[str, Any]) -> dict[str, Any]:
+        with self._lock:
+            self.requests += 1
+        delay = max(0.0, random.gauss(self.latency, self.jitter))
+        time.sleep(delay)
+        messages = body.get("messages", [])
+        prompt = messages[-1].get("content", "") if messages else ""
+        content = mock_verdict(prompt)
+        prompt_tokens = sum(len(m.get("content", "")) for m in messages) // 4
+        system_tokens = len(messages[0].get("content", "")) // 4 if messages else 0
+        return {
+            "id": f"mock-{self.requests}",
+            "object": "chat.completion",
+            "created": int(time.time()),
+            "model": body.get("model", "mock"),
+            "choices": [
+                {
+                    "index": 0,
+                    "message": {"role": "assistant", "content": content},
+                    "finish_reason": "stop",
+                }
+            ],
+            "usage": {
+                "prompt_tokens": prompt_tokens,
+                "completion_tokens": len(content) // 4,
+                "total_tokens": prompt_tokens + len(content) // 4,
+                # system 消息在所有请求间相同，视为命中前缀缓存
+                "prompt_tokens_details": {"cached_tokens": system_tokens},
+            },
+        }
+
+    def __enter__(self) -> "MockLLMServer":
+        self.thread.start()
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.httpd.shutdown()
+        self.httpd.server_close()
+
+
+def mock_verdict(prompt: str) -> str:
+    """根据 user 消息生成结论，格式与提示词要求的输出一致"""
+
+    def verdict(comment: str) -> dict[str, Any]:
+        comment = comment.strip()
+        typo = next((t for t in _TYPOS.values() if t in comment), None)
+        if typo is None:
+            return {"type": "Normal"}
+        fixed = {v: k for k, v in _TYPOS.items()}[typo]
+        return {
+            "type": "Typo",
+            "detail": f"{typo} should be {fixed}",
+            "replacement": comment.replace(typo, fixed),
+        }
+
+    return mock_content(prompt, verdict)
+
+
+def mock_llm(
+    config_dir: Path,
+    max_concurrency: int,
+    base_url: Optional[str] = None,
+    latency: float = 0.0,
+    jitter: float = 0.0,
+) -> LLM:
+    """
+    创建模拟 LLM 客户端，配置写入临时目录，不修改 llm_config
+
+    指定 base_url 时请求发往 MockLLMServer（包含 HTTP 开销）；
+    否则使用 corex.llms 中进程内的 mock provider。
+    """
+    keys_path = config_dir / "llm_keys.yaml"
+    model_config_path = config_dir / "model_config.yaml"
+    config: dict[str, Any] = {
+        "temperature": 0.0,
+        "max_concurrency": max_concurrency,
+        "timeout": 60,
+        "retry": {"max_retries": 2, "base_delay": 0.1},
+    }
+    if base_url is not None:
+        config.update(provider="local", base_url=base_url)
+    else:
+        config.update(
+            provider="mock",
+            mock={"distribution": "normal", "latency": latency, "jitter": jitter},
+        )
+    keys_path.write_text(yaml.safe_dump({"mock": "sk-mock"}))
+    model_config_path.write_text(yaml.safe_dump({"mock": config}))
+    return LLM("mock", keys_path=keys_path, model_config_path=model_config_path)
+
+
+# ---------------------------------------------------------------------------
+# 测量
+# ---------------------------------------------------------------------------
+
+
+def _corpus_files(language: str, corpus: Path) -> list[Path]:
+    return CommentExtractor(language).collect_files(corpus)
+
+
+def bench_extract(
+    language: str, corpus: Path, workers: int, repeat: int
+) -> dict[str, Any]:
+    """
+    测量提取吞吐，取 repeat 次中最快的一次；另跑一次 tracemalloc 统计内存峰值
+    （workers > 1 时只统计主进程）
+    """
+    extractor = CommentExtractor(language, workers=workers)
+    files = _corpus_files(language, corpus)
+    size = sum(f.stat().st_size for f in files)
+
+    timings, comments = [], 0
+    for _ in range(repeat):
+        start = time.perf_counter()
+        comments = sum(r["total_comments"] for r in extractor.iter_parse_files(files))
+        timings.append(time.perf_counter() - start)
+
+    tracemalloc.start()
+    for _ in extractor.iter_parse_files(files):
+        pass
+    _, peak = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+
+    best = min(timings)
+    return {
+        "files": len(files),
+        "bytes": size,
+        "comments": comments,
+        "seconds": best,
+        "seconds_median": statistics.median(timings),
+        "files_per_second": len(files) / best,
+        "mb_per_second": size / best / 1e6,
+        "comments_per_second": comments / best,
+        "tracemalloc_peak_mb": peak / 1e6,
+        "max_rss_mb": _max_rss_mb(),
+    }
+
+
+def bench_e2e(
+    language: str,
+    corpus: Path,
+    workers: int,
+    latency: float,
+    jitter: float,
+    max_concurrency: int,
+    batch_size: int,
+    dedup: bool,
+    backend: str = "http",
+) -> dict[str, Any]:
+    """
+    在模拟 LLM 上跑一次完整扫描（不使用分析缓存与检查点）
+
+    backend 为 http 时经过本地 HTTP 服务，为 inprocess 时使用进程内的 mock provider
+    """
+    if backend not in ("http", "inprocess"):
+        raise ValueError(f"Unsupported backend: {backend}")
+    server = MockLLMServer(latency, jitter) if backend == "http" else None
+    with server or nullcontext(), tempfile.TemporaryDirectory() as tmp:
+        tmp_dir = Path(tmp)
+        if server is not None:
+            llms = mock_llm(tmp_dir, max_concurrency, base_url=server.base_url)
+        else:
+            llms = mock_llm(tmp_dir, max_concurrency, latency=latency, jitter=jitter)
+        save_path = tmp_dir / "report.log"
+        corex = CoRex(
+            file_path=corpus,
+            extractor=CommentExtractor(language, workers=workers),
+            analyzer=AnalyzerWithoutContext(llms, batch_size=batch_size),
+            save_path=save_path,
+            max_concurrency=max_concurrency,
+            prefilter=PreFilter(),
+            dedup=dedup,
+            report=ReportSink.from_formats(save_path, ["text"]),
+        )
+        start = time.perf_counter()
+        corex.run()
+        seconds = time.perf_counter() - start
+        summary = METRICS.summary()
+
+    counters = summary["counters"]
+    latency_hist = summary["histograms"].get("llm_latency_seconds", {})
+    return {
+        "files": counters.get("files_parsed", 0),
+        "comments": counters.get("comments_analyzed", 0),
+        "requests": counters.get("llm_requests", 0),
+        "seconds": seconds,
+        "files_per_second": counters.get("files_parsed", 0) / seconds,
+        "comments_per_second": counters.get("comments_analyzed", 0) / seconds,
+        "llm_latency_p50": latency_hist.get("p50"),
+        "llm_latency_p95": latency_hist.get("p95"),
+        "llm_latency_p99": latency_hist.get("p99"),
+        "max_rss_mb": _max_rss_mb(),
+    }
+
+
+def _max_rss_mb() -> float:
+    # Linux 上 ru_maxrss 单位为 KB
+    usage = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    children = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss
+    return max(usage, children) / 1024
+
+
+# ---------------------------------------------------------------------------
+# 历史记录与回退检测
+# ---------------------------------------------------------------------------
+
+
+def _git_revision() -> Optional[str]:
+    try:
+        return subprocess.run(
+            ["git", "rev-parse", "--short", "HEAD"],
+            cwd=ROOT_DIR,
+            capture_output=True,
+            text=True,
+            check=True,
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def check_regression(
+    history_path: Path,
+    record: dict[str, Any],
+    tolerance: float,
+    window: int = 5,
+) -> list[str]:
+    """
+    与相同基准、相同配置的最近 window 条历史记录的中位数比较
+
+    Returns:
+        回退的指标描述，没有回退时为空
+    """
+    if not history_path.exists():
+        return []
+    previous = []
+    with open(history_path, "r", encoding="utf-8") as f:
+        for line in f:
+            try:
+                item = json.loads(line)
+            except json.JSONDecodeError:
+                continue
+            if item.get("bench") == record["bench"] and item.get("config") == (
+                record["config"]
+            ):
+                previous.append(item["results"])
+    previous = previous[-window:]
+    if not previous:
+        return []
+
+    regressions = []
+    for key in THROUGHPUT_KEYS:
+        values = [p[key] for p in previous if p.get(key)]
+        current = record["results"].get(key)
+        if not values or current is None:
+            continue
+        baseline = statistics.median(values)
+        if current < baseline * (1 - tolerance):
+            regressions.append(
+                f"{key}: {current:.2f} vs baseline {baseline:.2f} "
+                f"({current / baseline - 1:+.1%})"
+            )
+    return regressions
+
+
+def record_result(
+    bench: str,
+    config: dict[str, Any],
+    results: dict[str, Any],
+    history_path: Path,
+    tolerance: float,
+    fail_on_regression: bool,
+) -> None:
+    record = {
+        "bench": bench,
+        "timestamp": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "revision": _git_revision(),
+        "config": config,
+        "results": results,
+    }
+    logger.info(f"{bench} results: {json.dumps(results, indent=2)}")
+    regressions = check_regression(history_path, record, tolerance)
+
+    history_path.parent.mkdir(parents=True, exist_ok=True)
+    with open(history_path, "a", encoding="utf-8") as f:
+        f.write(json.dumps(record, ensure_ascii=False) + "\n")
+
+    if regressions:
+        for regression in regressions:
+            logger.warning(f"Performance regression in {bench}: {regression}")
+        if fail_on_regression:
+            raise typer.Exit(code=1)
+    else:
+        logger.success(f"No regression against {history_path}")
+
+
+def _prepare_corpus(
+    language: str, corpus: Optional[Path], files: int, units: int, tmp_dir: Path
+) -> tuple[Path, dict[str, Any]]:
+    if corpus is not None:
+        return corpus, {"corpus": str(corpus)}
+    generate_corpus(language, tmp_dir, files, units)
+    return tmp_dir, {"synthetic_files": files, "synthetic_units": units}
+
+
+@app.command()
+def extract(
+    language: str = typer.Option("python", help="Language of the corpus."),
+    corpus: Optional[Path] = typer.Option(
+        None, help="Real corpus directory (defaults to a synthetic corpus)."
+    ),
+    files: int = typer.Option(200, help="Synthetic corpus: number of files."),
+    units: int = typer.Option(50, help="Synthetic corpus: functions per file."),
+    workers: int = typer.Option(1, help="Extraction worker processes."),
+    repeat: int = typer.Option(3, help="Timed repetitions (the best is kept)."),
+    history_path: Path = typer.Option(HISTORY_PATH, help="JSONL result history."),
+    tolerance: float = typer.Option(0.1, help="Allowed throughput drop (0.1 = 10%)."),
+    fail_on_regression: bool = typer.Option(
+        False, help="Exit with status 1 on a regression."
+    ),
+):
+    """测量 CommentExtractor 的提取吞吐与内存峰值"""
+    with tempfile.TemporaryDirectory() as tmp:
+        path, corpus_config = _prepare_corpus(
+            language, corpus, files, units, Path(tmp)
+        )
+        results = bench_extract(language, path, workers, repeat)
+    config = {"language": language, "workers": workers, **corpus_config}
+    record_result(
+        "extract", config, results, history_path, tolerance, fail_on_regression
+    )
+
+
+@app.command()
+def e2e(
+    language: str = typer.Option("python", help="Language of the corpus."),
+    corpus: Optional[Path] = typer.Option(
+        None, help="Real corpus directory (defaults to a synthetic corpus)."
+    ),
+    files: int = typer.Option(50, help="Synthetic corpus: number of files."),
+    units: int = typer.Option(20, help="Synthetic corpus: functions per file."),
+    workers: int = typer.Option(1, help="Extraction worker processes."),
+    latency: float = typer.Option(0.2, help="Mock LLM mean latency in seconds."),
+    jitter: float = typer.Option(0.05, help="Mock LLM latency standard deviation."),
+    max_concurrency: int = typer.Option(32, help="Max in-flight LLM requests."),
+    batch_size: int = typer.Option(1, help="Comments packed into one request."),
+    dedup: bool = typer.Option(True, help="Deduplicate identical comments."),
+    backend: str = typer.Option(
+        "http", help="Mock LLM backend: http (local server) or inprocess."
+    ),
+    history_path: Path = typer.Option(HISTORY_PATH, help="JSONL result history."),
+    tolerance: float = typer.Option(0.1, help="Allowed throughput drop (0.1 = 10%)."),
+    fail_on_regression: bool = typer.Option(
+        False, help="Exit with status 1 on a regression."
+    ),
+):
+    """在模拟 LLM 服务上测量端到端扫描吞吐"""
+    with tempfile.TemporaryDirectory() as tmp:
+        path, corpus_config = _prepare_corpus(
+            language, corpus, files, units, Path(tmp)
+        )
+        results = bench_e2e(
+            language,
+            path,
+            workers,
+            latency,
+            jitter,
+            max_concurrency,
+            batch_size,
+            dedup,
+            backend,
+        )
+    config = {
+        "language": language,
+        "workers": workers,
+        "latency": latency,
+        "jitter": jitter,
+        "max_concurrency": max_concurrency,
+        "batch_size": batch_size,
+        "dedup": dedup,
+        "backend": backend,
+        **corpus_config,
+    }
+    record_result("e2e", config, results, history_path, tolerance, fail_on_regression)
+
+
+# python -m experiments.benchmark --help
+if __name__ == "__main__":
+    app()